@@ -0,0 +1,43 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+// Reusable barrier for host threads driving concurrent streams
+class Barrier
+{
+  protected:
+    std::mutex mutex;
+    std::condition_variable cv;
+    const unsigned int count;
+    unsigned int waiting = 0;
+    unsigned int generation = 0;
+
+  public:
+
+    explicit Barrier(const unsigned int count) : count(count) {}
+
+    void wait()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      const unsigned int arrived = generation;
+      if (++waiting == count)
+      {
+        waiting = 0;
+        generation++;
+        cv.notify_all();
+      }
+      else
+      {
+        cv.wait(lock, [&]{ return arrived != generation; });
+      }
+    }
+
+};
@@ -0,0 +1,58 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <stdexcept>
+
+// Per kernel bandwidth in MBytes/sec from a stored result. Reads the text
+// output of every version of this benchmark, where each kernel row starts
+// with its name and bandwidth, and McCalpin STREAM output, where rows look
+// like "Copy:   92980.4  ..." and Scale is the kernel called Mul here.
+// Only the first table after a "Function" header is used; later tables
+// (counters, energy, MPI, baseline comparisons) have rows of the same shape
+inline std::map<std::string, double> read_baseline(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Could not open baseline " + path);
+
+  std::map<std::string, double> bandwidth;
+  std::string line;
+  bool table = false;
+  while (std::getline(file, line))
+  {
+    std::istringstream row(line);
+    std::string name;
+    if (!table)
+    {
+      table = (row >> name) && name == "Function";
+      continue;
+    }
+
+    // The table ends at a blank line or the first row that is not a kernel
+    double rate;
+    if (!(row >> name >> rate))
+      break;
+    if (name.back() == ':')
+      name.pop_back();
+    if (name == "Scale")
+      name = "Mul";
+    if (name != "Copy" && name != "Mul" && name != "Add" && name != "Triad" && name != "Dot")
+      break;
+    bandwidth[name] = rate;
+  }
+
+  if (bandwidth.empty())
+    throw std::runtime_error("No kernel results in baseline " + path);
+  return bandwidth;
+}
+
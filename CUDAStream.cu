@@ -63,6 +63,10 @@ CUDAStream<T>::CUDAStream(const unsigned int ARRAY_SIZE, const int device_index)
   check_error();
   cudaMalloc(&d_sum, DOT_NUM_BLOCKS*sizeof(T));
   check_error();
+  cudaMalloc(&d_result, sizeof(T));
+  check_error();
+  cudaMallocHost(&h_result, sizeof(T));
+  check_error();
 }
 
 
@@ -79,6 +83,22 @@ CUDAStream<T>::~CUDAStream()
   check_error();
   cudaFree(d_sum);
   check_error();
+  cudaFree(d_result);
+  check_error();
+  cudaFreeHost(h_result);
+  check_error();
+
+  if (h_pinned[0])
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      free(h_pageable[i]);
+      cudaFreeHost(h_pinned[i]);
+      check_error();
+      cudaStreamDestroy(transfer_streams[i]);
+      check_error();
+    }
+  }
 }
 
 
@@ -179,6 +199,52 @@ void CUDAStream<T>::triad()
   check_error();
 }
 
+template <typename T, unsigned int FMAS>
+__global__ void intensity_kernel(T * a, const T * b, const T * c)
+{
+  const T scalar = startScalar;
+  const unsigned int chains = FMAS < INTENSITY_CHAINS ? FMAS : INTENSITY_CHAINS;
+  const int i = blockDim.x * blockIdx.x + threadIdx.x;
+
+  T x[chains];
+  #pragma unroll
+  for (unsigned int j = 0; j < chains; j++)
+    x[j] = b[i] + j;
+  for (unsigned int f = 0; f < FMAS / chains; f++)
+    #pragma unroll
+    for (unsigned int j = 0; j < chains; j++)
+      x[j] = x[j] * scalar + c[i];
+  T sum = x[0];
+  #pragma unroll
+  for (unsigned int j = 1; j < chains; j++)
+    sum += x[j];
+  a[i] = sum;
+}
+
+template <class T>
+void CUDAStream<T>::intensity_triad(unsigned int fmas)
+{
+  const int blocks = array_size/TBSIZE;
+  switch (fmas)
+  {
+    case 1:   intensity_kernel<T, 1><<<blocks, TBSIZE>>>(d_a, d_b, d_c);   break;
+    case 2:   intensity_kernel<T, 2><<<blocks, TBSIZE>>>(d_a, d_b, d_c);   break;
+    case 4:   intensity_kernel<T, 4><<<blocks, TBSIZE>>>(d_a, d_b, d_c);   break;
+    case 8:   intensity_kernel<T, 8><<<blocks, TBSIZE>>>(d_a, d_b, d_c);   break;
+    case 16:  intensity_kernel<T, 16><<<blocks, TBSIZE>>>(d_a, d_b, d_c);  break;
+    case 32:  intensity_kernel<T, 32><<<blocks, TBSIZE>>>(d_a, d_b, d_c);  break;
+    case 64:  intensity_kernel<T, 64><<<blocks, TBSIZE>>>(d_a, d_b, d_c);  break;
+    case 128: intensity_kernel<T, 128><<<blocks, TBSIZE>>>(d_a, d_b, d_c); break;
+    case 256: intensity_kernel<T, 256><<<blocks, TBSIZE>>>(d_a, d_b, d_c); break;
+    case 512: intensity_kernel<T, 512><<<blocks, TBSIZE>>>(d_a, d_b, d_c); break;
+    default:
+      throw std::runtime_error("FMAs per element must be a power of two up to 512");
+  }
+  check_error();
+  cudaDeviceSynchronize();
+  check_error();
+}
+
 template <class T>
 __global__ void dot_kernel(const T * a, const T * b, T * sum, unsigned int array_size)
 {
@@ -220,6 +286,94 @@ T CUDAStream<T>::dot()
   return sum;
 }
 
+template <class T>
+__global__ void dot_final_kernel(const T * sum, T * result, unsigned int num_sums)
+{
+  __shared__ T tb_sum[TBSIZE];
+
+  const size_t local_i = threadIdx.x;
+
+  tb_sum[local_i] = 0.0;
+  for (int i = local_i; i < num_sums; i += blockDim.x)
+    tb_sum[local_i] += sum[i];
+
+  for (int offset = blockDim.x / 2; offset > 0; offset /= 2)
+  {
+    __syncthreads();
+    if (local_i < offset)
+    {
+      tb_sum[local_i] += tb_sum[local_i+offset];
+    }
+  }
+
+  if (local_i == 0)
+    result[0] = tb_sum[local_i];
+}
+
+template <class T>
+T CUDAStream<T>::dot_on_device()
+{
+  dot_kernel<<<DOT_NUM_BLOCKS, TBSIZE>>>(d_a, d_b, d_sum, array_size);
+  check_error();
+  dot_final_kernel<<<1, TBSIZE>>>(d_sum, d_result, DOT_NUM_BLOCKS);
+  check_error();
+
+  cudaMemcpy(h_result, d_result, sizeof(T), cudaMemcpyDeviceToHost);
+  check_error();
+
+  return *h_result;
+}
+
+template <class T>
+void CUDAStream<T>::init_transfers()
+{
+  const size_t bytes = sizeof(T) * array_size;
+
+  for (int i = 0; i < 2; i++)
+  {
+    h_pageable[i] = (char*)malloc(bytes);
+    cudaMallocHost(&h_pinned[i], bytes);
+    check_error();
+    cudaStreamCreate(&transfer_streams[i]);
+    check_error();
+  }
+}
+
+template <class T>
+void CUDAStream<T>::transfer(Transfer dir, bool pinned, size_t bytes)
+{
+  if (bytes > sizeof(T) * array_size)
+    throw std::runtime_error("Transfer is larger than the device buffers");
+
+  if (!h_pinned[0])
+    init_transfers();
+
+  char *upload = pinned ? h_pinned[0] : h_pageable[0];
+  char *download = pinned ? h_pinned[1] : h_pageable[1];
+
+  switch (dir)
+  {
+    case Transfer::HostToDevice:
+      cudaMemcpy(d_a, upload, bytes, cudaMemcpyHostToDevice);
+      break;
+    case Transfer::DeviceToHost:
+      cudaMemcpy(download, d_b, bytes, cudaMemcpyDeviceToHost);
+      break;
+    case Transfer::DeviceToDevice:
+      cudaMemcpy(d_c, d_a, bytes, cudaMemcpyDeviceToDevice);
+      break;
+    case Transfer::Bidirectional:
+      // Copies from pageable memory are staged by the driver and will not overlap
+      cudaMemcpyAsync(d_a, upload, bytes, cudaMemcpyHostToDevice, transfer_streams[0]);
+      check_error();
+      cudaMemcpyAsync(download, d_b, bytes, cudaMemcpyDeviceToHost, transfer_streams[1]);
+      break;
+  }
+  check_error();
+  cudaDeviceSynchronize();
+  check_error();
+}
+
 void listDevices(void)
 {
   // Get number of devices
@@ -33,7 +33,20 @@ class CUDAStream : public Stream<T>
     T *d_b;
     T *d_c;
     T *d_sum;
+    T *d_result;
 
+    // Pinned host copy of the fully reduced dot result
+    T *h_result;
+
+    // Host staging for the transfer benchmark, allocated on first use
+    // Index 0 is uploaded from and index 1 is downloaded into
+    char *h_pageable[2] = {nullptr, nullptr};
+    char *h_pinned[2] = {nullptr, nullptr};
+
+    // Streams so uploads and downloads can run concurrently
+    cudaStream_t transfer_streams[2];
+
+    void init_transfers();
 
   public:
 
@@ -49,4 +62,8 @@ class CUDAStream : public Stream<T>
     virtual void init_arrays(T initA, T initB, T initC) override;
     virtual void read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) override;
 
+    virtual void transfer(Transfer dir, bool pinned, size_t bytes) override;
+    virtual T dot_on_device() override;
+    virtual void intensity_triad(unsigned int fmas) override;
+
 };
@@ -0,0 +1,200 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// Bytes moved by one memory controller CAS command
+#define CAS_BYTES 64
+
+// Hardware performance counters read through perf_event_open. Core events
+// count this process and threads it creates after the counters are opened;
+// memory controller (uncore IMC) events count the whole socket. Events that
+// cannot be opened, for example because of perf_event_paranoid or a
+// container seccomp policy, are reported as unavailable
+class Counters
+{
+  public:
+    enum Event {Cycles, Instructions, LLCMisses, DRAMBytes, NumEvents};
+
+  protected:
+    // Open counters making up each event; DRAMBytes sums one read and one
+    // write counter per memory controller
+    std::vector<int> fds[NumEvents];
+    std::string reasons;
+
+#ifdef __linux__
+    int open_event(const uint32_t type, const uint64_t config, const int pid, const int cpu)
+    {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.inherit = pid == 0;
+      attr.exclude_kernel = pid == 0;
+      attr.exclude_hv = 1;
+      return syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0);
+    }
+
+    static std::string read_line(const std::string& path)
+    {
+      std::ifstream file(path);
+      std::string line;
+      std::getline(file, line);
+      return line;
+    }
+
+    // Encode a sysfs event description such as "event=0x04,umask=0x03"
+    // using the bit ranges in the PMU format directory
+    static uint64_t encode_event(const std::string& pmu, const std::string& event)
+    {
+      uint64_t config = 0;
+      std::stringstream terms(event);
+      std::string term;
+      while (std::getline(terms, term, ','))
+      {
+        const size_t eq = term.find('=');
+        const std::string name = term.substr(0, eq);
+        const uint64_t value = eq == std::string::npos ? 1 : std::stoull(term.substr(eq + 1), nullptr, 0);
+
+        // Format is "config:first-last" or "config:bit"
+        const std::string format = read_line(pmu + "/format/" + name);
+        const size_t colon = format.find(':');
+        if (format.compare(0, colon, "config") || colon == std::string::npos)
+          continue;
+        config |= value << std::stoi(format.substr(colon + 1));
+      }
+      return config;
+    }
+
+    void open_imc()
+    {
+      const std::string devices = "/sys/bus/event_source/devices/";
+
+      // One CPU per socket, as listed by the PMU
+      for (int imc = 0; ; imc++)
+      {
+        const std::string pmu = devices + "uncore_imc_" + std::to_string(imc);
+        const std::string type = read_line(pmu + "/type");
+        if (type.empty())
+        {
+          if (imc == 0)
+            reasons += " no uncore IMC PMU;";
+          return;
+        }
+
+        std::stringstream cpumask(read_line(pmu + "/cpumask"));
+        std::string cpu;
+        while (std::getline(cpumask, cpu, ','))
+        {
+          for (const char *name : {"cas_count_read", "cas_count_write"})
+          {
+            const std::string event = read_line(pmu + "/events/" + name);
+            int fd = event.empty() ? -1 : open_event(std::stoul(type), encode_event(pmu, event), -1, std::stoi(cpu));
+            if (fd < 0)
+            {
+              if (reasons.find("IMC") == std::string::npos)
+                reasons += std::string(" IMC: ") + (event.empty() ? "no CAS events" : strerror(errno)) + ";";
+              close_all(DRAMBytes);
+              return;
+            }
+            fds[DRAMBytes].push_back(fd);
+          }
+        }
+      }
+    }
+
+    void close_all(const Event event)
+    {
+      for (int fd : fds[event])
+        close(fd);
+      fds[event].clear();
+    }
+#endif
+
+  public:
+
+    Counters()
+    {
+#ifdef __linux__
+      const struct
+      {
+        Event event;
+        uint64_t config;
+        const char *name;
+      } core[] = {
+        {Cycles,       PERF_COUNT_HW_CPU_CYCLES,   "cycles"},
+        {Instructions, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+        {LLCMisses,    PERF_COUNT_HW_CACHE_MISSES, "LLC misses"}
+      };
+      for (auto& c : core)
+      {
+        int fd = open_event(PERF_TYPE_HARDWARE, c.config, 0, -1);
+        if (fd < 0)
+          reasons += std::string(" ") + c.name + ": " + strerror(errno) + ";";
+        else
+          fds[c.event].push_back(fd);
+      }
+      open_imc();
+#else
+      reasons = " perf_event_open needs Linux;";
+#endif
+    }
+
+    ~Counters()
+    {
+#ifdef __linux__
+      for (int e = 0; e < NumEvents; e++)
+        close_all((Event)e);
+#endif
+    }
+
+    bool available(const Event event) const
+    {
+      return !fds[event].empty();
+    }
+
+    // Why events are unavailable, empty if all could be opened
+    const std::string& unavailable() const
+    {
+      return reasons;
+    }
+
+    // Current totals of every event, with DRAM traffic in bytes
+    void read(uint64_t values[NumEvents])
+    {
+      for (int e = 0; e < NumEvents; e++)
+      {
+        values[e] = 0;
+#ifdef __linux__
+        for (int fd : fds[e])
+        {
+          uint64_t count = 0;
+          if (::read(fd, &count, sizeof(count)) == sizeof(count))
+            values[e] += count;
+        }
+#endif
+      }
+      values[DRAMBytes] *= CAS_BYTES;
+    }
+
+};
+
@@ -0,0 +1,115 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <dirent.h>
+
+// Default location of the powercap (RAPL) energy counters
+#define POWERCAP_ROOT "/sys/class/powercap"
+
+// Package and DRAM energy counters from the Linux powercap interface, as
+// provided by the intel-rapl driver on both Intel and AMD processors. Each
+// zone directory under the root holds name, energy_uj and
+// max_energy_range_uj files
+class Energy
+{
+  public:
+    enum Domain {Package, DRAM, NumDomains};
+
+  protected:
+    struct Zone
+    {
+      Domain domain;
+      std::string path;
+      uint64_t range;
+    };
+    std::vector<Zone> zones;
+
+    static bool read_value(const std::string& path, std::string& value)
+    {
+      std::ifstream file(path);
+      return (bool)(file >> value);
+    }
+
+  public:
+
+    explicit Energy(const std::string& root)
+    {
+      DIR *dir = opendir(root.c_str());
+      if (!dir)
+        return;
+
+      std::vector<std::string> entries;
+      while (struct dirent *entry = readdir(dir))
+        entries.push_back(entry->d_name);
+      closedir(dir);
+      std::sort(entries.begin(), entries.end());
+
+      for (const std::string& entry : entries)
+      {
+        // Zones are named like intel-rapl:0 and intel-rapl:0:1. The MMIO
+        // interface (intel-rapl-mmio:0) repeats the package zone, so it
+        // would be counted twice
+        if (entry.compare(0, 11, "intel-rapl:") != 0)
+          continue;
+
+        const std::string path = root + "/" + entry + "/";
+        std::string name, energy, range;
+        if (!read_value(path + "name", name) || !read_value(path + "energy_uj", energy))
+          continue;
+
+        Zone zone;
+        if (name.compare(0, 7, "package") == 0)
+          zone.domain = Package;
+        else if (name == "dram")
+          zone.domain = DRAM;
+        else
+          continue;
+        zone.path = path + "energy_uj";
+        zone.range = read_value(path + "max_energy_range_uj", range) ? std::stoull(range) : 0;
+        zones.push_back(zone);
+      }
+    }
+
+    bool available(const Domain domain) const
+    {
+      return std::any_of(zones.begin(), zones.end(), [&](const Zone& zone){ return zone.domain == domain; });
+    }
+
+    // Current value of each zone counter in microjoules
+    void read(std::vector<uint64_t>& values) const
+    {
+      values.resize(zones.size());
+      for (size_t z = 0; z < zones.size(); z++)
+      {
+        std::string value;
+        values[z] = read_value(zones[z].path, value) ? std::stoull(value) : 0;
+      }
+    }
+
+    // Joules used in each domain between two readings, allowing for each
+    // counter wrapping around once
+    void joules(const std::vector<uint64_t>& start, const std::vector<uint64_t>& end, double used[NumDomains]) const
+    {
+      for (int d = 0; d < NumDomains; d++)
+        used[d] = 0.0;
+      for (size_t z = 0; z < zones.size(); z++)
+      {
+        const uint64_t delta = end[z] >= start[z] ? end[z] - start[z] : zones[z].range - start[z] + end[z];
+        used[zones[z].domain] += 1.0E-6 * delta;
+      }
+    }
+
+};
+
@@ -0,0 +1,201 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cctype>
+#include <cstdlib>
+
+// Elementwise expression over the benchmark arrays, such as
+//   a = b + s*c*c
+// One of the arrays a, b or c is assigned from the arrays, the scalar s
+// (startScalar), numeric constants, + - * / and parentheses
+class Expr
+{
+  protected:
+    struct Node
+    {
+      char op;        // One of + - * /, 'n'egate, 'a'rray, 's'calar or 'c'onstant
+      int array;      // Array index for 'a'
+      std::string constant;
+      std::unique_ptr<Node> lhs, rhs;
+    };
+
+    std::string source;
+    size_t pos = 0;
+
+    int dst;
+    bool read[3] = {false, false, false};
+    std::unique_ptr<Node> root;
+
+    void fail(const std::string& what) const
+    {
+      throw std::runtime_error("Invalid expression '" + source + "': " + what);
+    }
+
+    char peek()
+    {
+      while (pos < source.size() && isspace(source[pos]))
+        pos++;
+      return pos < source.size() ? source[pos] : '\0';
+    }
+
+    int parse_array()
+    {
+      char name = peek();
+      if (name < 'a' || name > 'c' || (pos + 1 < source.size() && isalnum(source[pos + 1])))
+        fail("expected one of a, b or c");
+      pos++;
+      return name - 'a';
+    }
+
+    // expr := term (('+' | '-') term)*
+    std::unique_ptr<Node> parse_expr()
+    {
+      std::unique_ptr<Node> node = parse_term();
+      while (peek() == '+' || peek() == '-')
+      {
+        std::unique_ptr<Node> op(new Node);
+        op->op = source[pos++];
+        op->lhs = std::move(node);
+        op->rhs = parse_term();
+        node = std::move(op);
+      }
+      return node;
+    }
+
+    // term := factor (('*' | '/') factor)*
+    std::unique_ptr<Node> parse_term()
+    {
+      std::unique_ptr<Node> node = parse_factor();
+      while (peek() == '*' || peek() == '/')
+      {
+        std::unique_ptr<Node> op(new Node);
+        op->op = source[pos++];
+        op->lhs = std::move(node);
+        op->rhs = parse_factor();
+        node = std::move(op);
+      }
+      return node;
+    }
+
+    // factor := '-' factor | '(' expr ')' | a | b | c | s | constant
+    std::unique_ptr<Node> parse_factor()
+    {
+      std::unique_ptr<Node> node(new Node);
+      char next = peek();
+
+      if (next == '-')
+      {
+        pos++;
+        node->op = 'n';
+        node->lhs = parse_factor();
+      }
+      else if (next == '(')
+      {
+        pos++;
+        node = parse_expr();
+        if (peek() != ')')
+          fail("expected ')'");
+        pos++;
+      }
+      else if (next == 's' && !(pos + 1 < source.size() && isalnum(source[pos + 1])))
+      {
+        pos++;
+        node->op = 's';
+      }
+      else if (isdigit(next) || next == '.')
+      {
+        const char *start = source.c_str() + pos;
+        char *end;
+        strtod(start, &end);
+        if (end == start)
+          fail("bad constant");
+        node->op = 'c';
+        node->constant = std::string(start, end - start);
+        pos += end - start;
+      }
+      else
+      {
+        node->op = 'a';
+        node->array = parse_array();
+        read[node->array] = true;
+      }
+      return node;
+    }
+
+    std::string code(const Node& node) const
+    {
+      switch (node.op)
+      {
+        case 'a': return std::string(1, 'a' + node.array) + "[i]";
+        case 's': return "s";
+        case 'c': return "((TYPE)" + node.constant + ")";
+        case 'n': return "(-" + code(*node.lhs) + ")";
+        default:  return "(" + code(*node.lhs) + " " + node.op + " " + code(*node.rhs) + ")";
+      }
+    }
+
+    template <typename T>
+    T evaluate(const Node& node, const T v[3], const T s) const
+    {
+      switch (node.op)
+      {
+        case 'a': return v[node.array];
+        case 's': return s;
+        case 'c': return (T)strtod(node.constant.c_str(), nullptr);
+        case 'n': return -evaluate(*node.lhs, v, s);
+        case '+': return evaluate(*node.lhs, v, s) + evaluate(*node.rhs, v, s);
+        case '-': return evaluate(*node.lhs, v, s) - evaluate(*node.rhs, v, s);
+        case '*': return evaluate(*node.lhs, v, s) * evaluate(*node.rhs, v, s);
+        default:  return evaluate(*node.lhs, v, s) / evaluate(*node.rhs, v, s);
+      }
+    }
+
+  public:
+
+    explicit Expr(const std::string& source) : source(source)
+    {
+      dst = parse_array();
+      if (peek() != '=')
+        fail("expected '='");
+      pos++;
+      root = parse_expr();
+      if (peek() != '\0')
+        fail("unexpected '" + source.substr(pos) + "'");
+    }
+
+    const std::string& str() const { return source; }
+
+    // Index of the array assigned to: 0, 1 or 2 for a, b or c
+    int target() const { return dst; }
+
+    // Number of distinct arrays read, each read once per element
+    unsigned int arrays_read() const
+    {
+      return read[0] + read[1] + read[2];
+    }
+
+    // C statement assigning element i, for use in a generated kernel with
+    // arrays a, b and c, scalar s and element type TYPE
+    std::string code() const
+    {
+      return std::string(1, 'a' + dst) + "[i] = " + code(*root);
+    }
+
+    // Apply the expression to a single element on the host
+    template <typename T>
+    void apply(T v[3], const T s) const
+    {
+      v[dst] = evaluate(*root, v, s);
+    }
+
+};
+
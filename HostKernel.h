@@ -0,0 +1,158 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <type_traits>
+
+// Expression templates for kernels over host resident arrays. A kernel is
+// written once as an assignment over the array handles, for example
+//   host_kernels::Array<T, 0> a;
+//   host_kernels::Array<T, 1> b;
+//   host_kernels::Array<T, 2> c;
+//   host_kernels::Scalar<T> s(startScalar);
+//   auto triad = (a = b + s * c);
+// which expands into a single loop at compile time. The bytes moved per
+// element are also known at compile time: each array read is loaded once,
+// and the assigned array is stored once
+namespace host_kernels
+{
+  // Number of arrays marked in a bitmask
+  constexpr unsigned int count_arrays(unsigned int mask)
+  {
+    return mask ? (mask & 1) + count_arrays(mask >> 1) : 0;
+  }
+
+  template <class T, class E, int N> struct Assign;
+
+  // Handle to array N, one of a, b or c
+  template <class T, int N>
+  struct Array
+  {
+    static constexpr unsigned int reads = 1u << N;
+
+    T eval(T * const p[3], const size_t i) const { return p[N][i]; }
+
+    template <class E>
+    Assign<T, E, N> operator=(const E& e) const { return Assign<T, E, N>(e); }
+
+    // Assigning an array to itself is not a kernel
+    Array& operator=(const Array&) = delete;
+  };
+
+  // Value fixed for the whole kernel
+  template <class T>
+  struct Scalar
+  {
+    static constexpr unsigned int reads = 0;
+
+    T value;
+    explicit Scalar(const T value) : value(value) {}
+
+    template <class U>
+    U eval(U * const p[3], const size_t i) const { return value; }
+  };
+
+  struct Plus  { template <class T> static T apply(T l, T r) { return l + r; } };
+  struct Minus { template <class T> static T apply(T l, T r) { return l - r; } };
+  struct Times { template <class T> static T apply(T l, T r) { return l * r; } };
+  struct Over  { template <class T> static T apply(T l, T r) { return l / r; } };
+
+  template <class Op, class L, class R>
+  struct Binary
+  {
+    static constexpr unsigned int reads = L::reads | R::reads;
+
+    L lhs;
+    R rhs;
+    Binary(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs) {}
+
+    template <class T>
+    T eval(T * const p[3], const size_t i) const
+    {
+      return Op::apply(lhs.eval(p, i), rhs.eval(p, i));
+    }
+  };
+
+  // Kernel assigning expression E to array N
+  template <class T, class E, int N>
+  struct Assign
+  {
+    static constexpr unsigned int arrays_read = count_arrays(E::reads);
+    static constexpr size_t bytes = (arrays_read + 1) * sizeof(T);
+
+    E e;
+    explicit Assign(const E& e) : e(e) {}
+
+    void operator()(T * const p[3], const size_t n) const
+    {
+      T * const out = p[N];
+#ifdef _OPENMP
+      #pragma omp parallel for simd
+#endif
+      for (size_t i = 0; i < n; i++)
+        out[i] = e.eval(p, i);
+    }
+
+    // Apply the kernel to a single element on the host, for validation
+    void apply(T v[3]) const
+    {
+      T * const p[3] = {&v[0], &v[1], &v[2]};
+      v[N] = e.eval(p, 0);
+    }
+  };
+
+  // Operators are only defined for expressions, with plain numbers on
+  // either side converted to Scalar
+  template <class E> struct is_expr : std::false_type {};
+  template <class T, int N> struct is_expr<Array<T, N>> : std::true_type {};
+  template <class T> struct is_expr<Scalar<T>> : std::true_type {};
+  template <class Op, class L, class R> struct is_expr<Binary<Op, L, R>> : std::true_type {};
+
+  template <class E>
+  const E& as_expr(const E& e, typename std::enable_if<is_expr<E>::value>::type* = nullptr) { return e; }
+  template <class T>
+  Scalar<T> as_expr(const T& v, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr) { return Scalar<T>(v); }
+
+  template <class L, class R>
+  using enable_binary = typename std::enable_if<is_expr<L>::value || is_expr<R>::value>::type;
+
+#define HOST_KERNEL_OPERATOR(SYMBOL, OP)                                              \
+  template <class L, class R, class = enable_binary<L, R>>                            \
+  auto operator SYMBOL(const L& l, const R& r)                                        \
+    -> Binary<OP, typename std::decay<decltype(as_expr<L>(l))>::type,                 \
+                  typename std::decay<decltype(as_expr<R>(r))>::type>                 \
+  {                                                                                   \
+    return {as_expr<L>(l), as_expr<R>(r)};                                            \
+  }
+
+  HOST_KERNEL_OPERATOR(+, Plus)
+  HOST_KERNEL_OPERATOR(-, Minus)
+  HOST_KERNEL_OPERATOR(*, Times)
+  HOST_KERNEL_OPERATOR(/, Over)
+
+#undef HOST_KERNEL_OPERATOR
+
+  // Kernel registered with the harness by name
+  template <class T>
+  struct Kernel
+  {
+    std::string name;
+    size_t bytes;  // Per element
+    std::function<void(T * const p[3], const size_t n)> run;
+    std::function<void(T v[3])> apply;
+  };
+
+  template <class T, class E, int N>
+  Kernel<T> make_kernel(const std::string& name, const Assign<T, E, N>& kernel)
+  {
+    return {name, Assign<T, E, N>::bytes, kernel, [kernel](T v[3]){ kernel.apply(v); }};
+  }
+}
+
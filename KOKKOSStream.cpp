@@ -63,6 +63,26 @@ void KOKKOSStream<T>::read_arrays(
   }
 }
 
+#ifdef KOKKOS_TARGET_CPU
+template <class T>
+void KOKKOSStream<T>::host_arrays(T **a, T **b, T **c)
+{
+  *a = d_a->data();
+  *b = d_b->data();
+  *c = d_c->data();
+}
+#endif
+
+template <class T>
+bool KOKKOSStream<T>::write_allocate()
+{
+#if defined(KOKKOS_TARGET_CPU) && !defined(STREAMING_STORES)
+  return true;
+#else
+  return false;
+#endif
+}
+
 template <class T>
 void KOKKOSStream<T>::copy()
 {
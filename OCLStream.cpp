@@ -11,6 +11,7 @@
 bool cached = false;
 std::vector<cl::Device> devices;
 void getDeviceList(void);
+cl::Device getDevice(const int device_index);
 
 std::string kernels{R"CLC(
 
@@ -88,19 +89,154 @@ std::string kernels{R"CLC(
       sum[get_group_id(0)] = wg_sum[local_i];
   }
 
+  kernel void stream_dot_final(
+    global const TYPE * restrict sum,
+    global TYPE * restrict result,
+    local TYPE * restrict wg_sum,
+    int num_sums)
+  {
+    const size_t local_i = get_local_id(0);
+    wg_sum[local_i] = 0.0;
+    for (size_t i = local_i; i < num_sums; i += get_local_size(0))
+      wg_sum[local_i] += sum[i];
+
+    for (int offset = get_local_size(0) / 2; offset > 0; offset /= 2)
+    {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if (local_i < offset)
+      {
+        wg_sum[local_i] += wg_sum[local_i+offset];
+      }
+    }
+
+    if (local_i == 0)
+      result[0] = wg_sum[local_i];
+  }
+
+  // The local memory kernels stage LOCAL_ELEMENTS elements per work-item,
+  // and the work-group size must be a power of two
+  kernel void local_copy(
+    global TYPE * restrict out,
+    local TYPE * restrict scratch,
+    int repeats)
+  {
+    const int li = get_local_id(0);
+    const int wgsize = get_local_size(0);
+    const int n = wgsize * LOCAL_ELEMENTS;
+    for (int j = li; j < n; j += wgsize)
+      scratch[j] = j;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Copy between the two halves of scratch, shifted by one element so
+    // that every pass depends on the writes of other work-items
+    for (int r = 0; r < repeats; r++)
+    {
+      local const TYPE * restrict src = scratch + (r & 1) * n;
+      local TYPE * restrict dst = scratch + n - (r & 1) * n;
+      for (int j = li; j < n; j += wgsize)
+        dst[j] = src[(j + 1) & (n - 1)];
+      barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    out[get_global_id(0)] = scratch[(repeats & 1) * n + li];
+  }
+
+  kernel void local_stride(
+    global TYPE * restrict out,
+    local TYPE * restrict scratch,
+    int repeats,
+    int stride)
+  {
+    const int li = get_local_id(0);
+    const int wgsize = get_local_size(0);
+    const int n = wgsize * LOCAL_ELEMENTS;
+    for (int j = li; j < n; j += wgsize)
+      scratch[j] = j;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    TYPE sum = 0.0;
+    for (int r = 0; r < repeats; r++)
+      for (int j = li; j < n; j += wgsize)
+        sum += scratch[(j * stride + r) & (n - 1)];
+
+    out[get_global_id(0)] = sum;
+  }
+
+  kernel void local_broadcast(
+    global TYPE * restrict out,
+    local TYPE * restrict scratch,
+    int repeats)
+  {
+    const int li = get_local_id(0);
+    const int wgsize = get_local_size(0);
+    const int n = wgsize * LOCAL_ELEMENTS;
+    for (int j = li; j < n; j += wgsize)
+      scratch[j] = j;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    TYPE sum = 0.0;
+    for (int r = 0; r < repeats; r++)
+      for (int e = 0; e < LOCAL_ELEMENTS; e++)
+        sum += scratch[(r * LOCAL_ELEMENTS + e) & (n - 1)];
+
+    out[get_global_id(0)] = sum;
+  }
+
+)CLC"};
+
+// Built separately, as devices without image support may reject them
+std::string image_kernels{R"CLC(
+
+  constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE | CLK_FILTER_NEAREST;
+  constant float scalar = startScalar;
+
+  kernel void image_copy(
+    read_only image2d_t a,
+    write_only image2d_t c)
+  {
+    const int2 pos = (int2)(get_global_id(0), get_global_id(1));
+    write_imagef(c, pos, read_imagef(a, sampler, pos));
+  }
+
+  kernel void image_triad(
+    write_only image2d_t a,
+    read_only image2d_t b,
+    read_only image2d_t c)
+  {
+    const int2 pos = (int2)(get_global_id(0), get_global_id(1));
+    write_imagef(a, pos, read_imagef(b, sampler, pos) + scalar * read_imagef(c, sampler, pos));
+  }
+
+  kernel void image_buffer_copy(
+    read_only image1d_buffer_t a,
+    write_only image1d_buffer_t c)
+  {
+    const int i = get_global_id(0);
+    write_imagef(c, i, read_imagef(a, i));
+  }
+
+  kernel void image_buffer_triad(
+    write_only image1d_buffer_t a,
+    read_only image1d_buffer_t b,
+    read_only image1d_buffer_t c)
+  {
+    const int i = get_global_id(0);
+    write_imagef(a, i, read_imagef(b, i) + scalar * read_imagef(c, i));
+  }
+
 )CLC"};
 
 
 template <class T>
 OCLStream<T>::OCLStream(const unsigned int ARRAY_SIZE, const int device_index)
+  : OCLStream(ARRAY_SIZE, getDevice(device_index))
 {
-  if (!cached)
-    getDeviceList();
+}
 
-  // Setup default OpenCL GPU
-  if (device_index >= devices.size())
-    throw std::runtime_error("Invalid device index");
-  device = devices[device_index];
+template <class T>
+OCLStream<T>::OCLStream(const unsigned int ARRAY_SIZE, const cl::Device& dev)
+{
+  device = dev;
 
   // Determine sensible dot kernel NDRange configuration
   if (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)
@@ -115,17 +251,19 @@ OCLStream<T>::OCLStream(const unsigned int ARRAY_SIZE, const int device_index)
   }
 
   // Print out device information
-  std::cout << "Using OpenCL device " << getDeviceName(device_index) << std::endl;
-  std::cout << "Driver: " << getDeviceDriver(device_index) << std::endl;
+  std::cout << "Using OpenCL device " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+  std::cout << "Driver: " << device.getInfo<CL_DRIVER_VERSION>() << std::endl;
   std::cout << "Reduction kernel config: " << dot_num_groups << " groups of size " << dot_wgsize << std::endl;
 
   context = cl::Context(device);
   queue = cl::CommandQueue(context);
+  partition_queues.push_back(queue);
 
   // Create program
   cl::Program program(context, kernels);
   std::ostringstream args;
   args << "-DstartScalar=" << startScalar << " ";
+  args << "-DLOCAL_ELEMENTS=" << LOCAL_ELEMENTS << " ";
   if (sizeof(T) == sizeof(double))
   {
     args << "-DTYPE=double";
@@ -158,6 +296,10 @@ OCLStream<T>::OCLStream(const unsigned int ARRAY_SIZE, const int device_index)
   add_kernel = new cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer>(program, "add");
   triad_kernel = new cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer>(program, "triad");
   dot_kernel = new cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::LocalSpaceArg, cl_int>(program, "stream_dot");
+  dot_final_kernel = new cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::LocalSpaceArg, cl_int>(program, "stream_dot_final");
+  local_copy_kernel = new cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int>(program, "local_copy");
+  local_stride_kernel = new cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int, cl_int>(program, "local_stride");
+  local_broadcast_kernel = new cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int>(program, "local_broadcast");
 
   array_size = ARRAY_SIZE;
 
@@ -174,58 +316,111 @@ OCLStream<T>::OCLStream(const unsigned int ARRAY_SIZE, const int device_index)
   d_b = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(T) * ARRAY_SIZE);
   d_c = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(T) * ARRAY_SIZE);
   d_sum = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(T) * dot_num_groups);
+  d_result = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(T));
 
   sums = std::vector<T>(dot_num_groups);
+
+  h_result = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, sizeof(T));
+  h_result_ptr = (T*)queue.enqueueMapBuffer(h_result, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, sizeof(T));
 }
 
 template <class T>
 OCLStream<T>::~OCLStream()
 {
+  queue.enqueueUnmapMemObject(h_result, h_result_ptr);
+  for (int i = 0; i < 2; i++)
+    if (h_pinned_ptr[i])
+      queue.enqueueUnmapMemObject(h_pinned[i], h_pinned_ptr[i]);
+  queue.finish();
+
+#ifdef cl_khr_command_buffer
+  if (command_buffer)
+    release_command_buffer(command_buffer);
+#endif
+
   delete init_kernel;
   delete copy_kernel;
   delete mul_kernel;
   delete add_kernel;
   delete triad_kernel;
+  delete dot_final_kernel;
+  delete local_copy_kernel;
+  delete local_stride_kernel;
+  delete local_broadcast_kernel;
+  delete expr_kernel;
+}
+
+template <class T>
+cl::EnqueueArgs OCLStream<T>::partition_args(unsigned int p)
+{
+  // Global IDs are offset to the start of the partition
+  const size_t begin = (size_t)p * array_size / num_partitions;
+  const size_t end = (size_t)(p + 1) * array_size / num_partitions;
+  cl::CommandQueue& q = partition_queues[p % partition_queues.size()];
+  return cl::EnqueueArgs(q, cl::NDRange(begin), cl::NDRange(end - begin), cl::NullRange);
+}
+
+template <class T>
+void OCLStream<T>::finish_partitions()
+{
+  for (cl::CommandQueue& q : partition_queues)
+    q.flush();
+  for (cl::CommandQueue& q : partition_queues)
+    q.finish();
+}
+
+template <class T>
+void OCLStream<T>::set_partitions(unsigned int count, bool out_of_order)
+{
+  if (count == 0 || count > array_size)
+    throw std::runtime_error("Invalid number of partitions");
+
+  partition_queues.clear();
+  if (out_of_order)
+  {
+    if (!(device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+      throw std::runtime_error("Device does not support out-of-order queues");
+    partition_queues.push_back(cl::CommandQueue(context, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE));
+  }
+  else
+  {
+    partition_queues.push_back(queue);
+    for (unsigned int i = 1; i < count; i++)
+      partition_queues.push_back(cl::CommandQueue(context));
+  }
+  num_partitions = count;
 }
 
 template <class T>
 void OCLStream<T>::copy()
 {
-  (*copy_kernel)(
-    cl::EnqueueArgs(queue, cl::NDRange(array_size)),
-    d_a, d_c
-  );
-  queue.finish();
+  for (unsigned int p = 0; p < num_partitions; p++)
+    (*copy_kernel)(partition_args(p), d_a, d_c);
+  finish_partitions();
 }
 
 template <class T>
 void OCLStream<T>::mul()
 {
-  (*mul_kernel)(
-    cl::EnqueueArgs(queue, cl::NDRange(array_size)),
-    d_b, d_c
-  );
-  queue.finish();
+  for (unsigned int p = 0; p < num_partitions; p++)
+    (*mul_kernel)(partition_args(p), d_b, d_c);
+  finish_partitions();
 }
 
 template <class T>
 void OCLStream<T>::add()
 {
-  (*add_kernel)(
-    cl::EnqueueArgs(queue, cl::NDRange(array_size)),
-    d_a, d_b, d_c
-  );
-  queue.finish();
+  for (unsigned int p = 0; p < num_partitions; p++)
+    (*add_kernel)(partition_args(p), d_a, d_b, d_c);
+  finish_partitions();
 }
 
 template <class T>
 void OCLStream<T>::triad()
 {
-  (*triad_kernel)(
-    cl::EnqueueArgs(queue, cl::NDRange(array_size)),
-    d_a, d_b, d_c
-  );
-  queue.finish();
+  for (unsigned int p = 0; p < num_partitions; p++)
+    (*triad_kernel)(partition_args(p), d_a, d_b, d_c);
+  finish_partitions();
 }
 
 template <class T>
@@ -244,6 +439,259 @@ T OCLStream<T>::dot()
   return sum;
 }
 
+template <class T>
+T OCLStream<T>::dot_on_device()
+{
+  (*dot_kernel)(
+    cl::EnqueueArgs(queue, cl::NDRange(dot_num_groups*dot_wgsize), cl::NDRange(dot_wgsize)),
+    d_a, d_b, d_sum, cl::Local(sizeof(T) * dot_wgsize), array_size
+  );
+  (*dot_final_kernel)(
+    cl::EnqueueArgs(queue, cl::NDRange(dot_wgsize), cl::NDRange(dot_wgsize)),
+    d_sum, d_result, cl::Local(sizeof(T) * dot_wgsize), dot_num_groups
+  );
+  queue.enqueueReadBuffer(d_result, CL_TRUE, 0, sizeof(T), h_result_ptr);
+
+  return *h_result_ptr;
+}
+
+template <class T>
+size_t OCLStream<T>::init_images(bool linear, bool half)
+{
+  if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>())
+    throw std::runtime_error("Device does not support images");
+
+  if (!image_program())
+  {
+    image_program = cl::Program(context, image_kernels);
+    std::ostringstream args;
+    args << "-DstartScalar=" << startScalar;
+    try
+    {
+      image_program.build(args.str().c_str());
+    }
+    catch (cl::Error& err)
+    {
+      if (err.err() == CL_BUILD_PROGRAM_FAILURE)
+        std::cout << image_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>()[0].second << std::endl;
+      throw err;
+    }
+  }
+
+  // Each RGBA pixel holds four array elements
+  const cl::ImageFormat format(CL_RGBA, half ? CL_HALF_FLOAT : CL_FLOAT);
+  const size_t pixel_size = half ? 8 : 16;
+  size_t pixels = array_size / 4;
+  cl::array<size_t, 3> region;
+
+  if (linear)
+  {
+    size_t max_pixels;
+    device.getInfo(CL_DEVICE_IMAGE_MAX_BUFFER_SIZE, &max_pixels);
+    pixels = std::min(pixels, max_pixels);
+
+    for (int i = 0; i < 3; i++)
+    {
+      d_image_store[i] = cl::Buffer(context, CL_MEM_READ_WRITE, pixels * pixel_size);
+      d_image1d[i] = cl::Image1DBuffer(context, CL_MEM_READ_WRITE, format, pixels, d_image_store[i]);
+    }
+
+    image_copy_kernel = cl::Kernel(image_program, "image_buffer_copy");
+    image_triad_kernel = cl::Kernel(image_program, "image_buffer_triad");
+    image_range = cl::NDRange(pixels);
+    region = {pixels, 1, 1};
+  }
+  else
+  {
+    // Rows of at most IMAGE_WIDTH pixels; the layout is left to the implementation
+    const size_t width = std::min<size_t>(IMAGE_WIDTH, device.getInfo<CL_DEVICE_IMAGE2D_MAX_WIDTH>());
+    const size_t height = std::min<size_t>(std::max<size_t>(pixels / width, 1), device.getInfo<CL_DEVICE_IMAGE2D_MAX_HEIGHT>());
+    pixels = width * height;
+
+    for (int i = 0; i < 3; i++)
+      d_image2d[i] = cl::Image2D(context, CL_MEM_READ_WRITE, format, width, height);
+
+    image_copy_kernel = cl::Kernel(image_program, "image_copy");
+    image_triad_kernel = cl::Kernel(image_program, "image_triad");
+    image_range = cl::NDRange(width, height);
+    region = {width, height, 1};
+  }
+
+  const cl::array<size_t, 3> origin = {0, 0, 0};
+  const cl_float init[3] = {(cl_float)startA, (cl_float)startB, (cl_float)startC};
+  for (int i = 0; i < 3; i++)
+  {
+    const cl::Image& image = linear ? static_cast<cl::Image&>(d_image1d[i]) : static_cast<cl::Image&>(d_image2d[i]);
+    const cl_float4 color = {{init[i], init[i], init[i], init[i]}};
+    queue.enqueueFillImage(image, color, origin, region);
+  }
+  queue.finish();
+
+  image_region = region;
+  image_linear = linear;
+  image_half = half;
+
+  if (linear)
+  {
+    image_copy_kernel.setArg(0, d_image1d[0]);
+    image_copy_kernel.setArg(1, d_image1d[2]);
+    image_triad_kernel.setArg(0, d_image1d[0]);
+    image_triad_kernel.setArg(1, d_image1d[1]);
+    image_triad_kernel.setArg(2, d_image1d[2]);
+  }
+  else
+  {
+    image_copy_kernel.setArg(0, d_image2d[0]);
+    image_copy_kernel.setArg(1, d_image2d[2]);
+    image_triad_kernel.setArg(0, d_image2d[0]);
+    image_triad_kernel.setArg(1, d_image2d[1]);
+    image_triad_kernel.setArg(2, d_image2d[2]);
+  }
+
+  return pixels * pixel_size;
+}
+
+template <class T>
+void OCLStream<T>::image_copy()
+{
+  queue.enqueueNDRangeKernel(image_copy_kernel, cl::NullRange, image_range, cl::NullRange);
+  queue.finish();
+}
+
+template <class T>
+void OCLStream<T>::image_triad()
+{
+  queue.enqueueNDRangeKernel(image_triad_kernel, cl::NullRange, image_range, cl::NullRange);
+  queue.finish();
+}
+
+// IEEE 754 half to float, for reading back half images
+static float half_to_float(const cl_half h)
+{
+  const int exponent = (h >> 10) & 0x1F;
+  const int mantissa = h & 0x3FF;
+  float value;
+  if (exponent == 0)
+    value = std::ldexp((float)mantissa, -24);
+  else if (exponent == 31)
+    value = mantissa ? NAN : INFINITY;
+  else
+    value = std::ldexp((float)(mantissa | 0x400), exponent - 25);
+  return (h & 0x8000) ? -value : value;
+}
+
+template <class T>
+void OCLStream<T>::read_images(std::vector<float>& a, std::vector<float>& b, std::vector<float>& c)
+{
+  const size_t elements = 4 * image_region[0] * image_region[1];
+  std::vector<cl_float> floats(image_half ? 0 : elements);
+  std::vector<cl_half> halves(image_half ? elements : 0);
+  void *raw = image_half ? (void *)halves.data() : (void *)floats.data();
+  const size_t raw_size = elements * (image_half ? sizeof(cl_half) : sizeof(cl_float));
+
+  const cl::array<size_t, 3> origin = {0, 0, 0};
+  std::vector<float> *arrays[3] = {&a, &b, &c};
+  for (int i = 0; i < 3; i++)
+  {
+    if (image_linear)
+      queue.enqueueReadBuffer(d_image_store[i], CL_TRUE, 0, raw_size, raw);
+    else
+      queue.enqueueReadImage(d_image2d[i], CL_TRUE, origin, image_region, 0, 0, raw);
+
+    arrays[i]->resize(elements);
+    for (size_t e = 0; e < elements; e++)
+      (*arrays[i])[e] = image_half ? half_to_float(halves[e]) : floats[e];
+  }
+}
+
+template <class T>
+size_t OCLStream<T>::local_bandwidth(LocalAccess pattern, unsigned int wgsize, unsigned int repeats, unsigned int stride)
+{
+  const size_t n = wgsize * LOCAL_ELEMENTS;
+  if (wgsize == 0 || (wgsize & (wgsize - 1)))
+    throw std::runtime_error("Work-group size must be a power of two");
+  if (wgsize > device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>())
+    throw std::runtime_error("Work-group size is too large for the device");
+  if (2 * n * sizeof(T) > device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())
+    throw std::runtime_error("Device does not have enough local memory for the work-group size");
+
+  // Enough work-groups to occupy the device, as for the dot kernel
+  const size_t global = dot_num_groups * wgsize;
+  if (local_size != global)
+  {
+    d_local = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(T) * global);
+    local_size = global;
+  }
+
+  cl::EnqueueArgs args(queue, cl::NDRange(global), cl::NDRange(wgsize));
+  size_t accessed = dot_num_groups * n * repeats * sizeof(T);
+  switch (pattern)
+  {
+    case LocalAccess::Copy:
+      (*local_copy_kernel)(args, d_local, cl::Local(2 * n * sizeof(T)), repeats);
+      accessed *= 2;
+      break;
+    case LocalAccess::Stride:
+      (*local_stride_kernel)(args, d_local, cl::Local(n * sizeof(T)), repeats, stride);
+      break;
+    case LocalAccess::Broadcast:
+      (*local_broadcast_kernel)(args, d_local, cl::Local(n * sizeof(T)), repeats);
+      break;
+  }
+  queue.finish();
+
+  return accessed;
+}
+
+template <class T>
+void OCLStream<T>::init_expr(const std::string& code)
+{
+  std::ostringstream source;
+  source
+    << "kernel void stream_expr(" << std::endl
+    << "  global TYPE * restrict a," << std::endl
+    << "  global TYPE * restrict b," << std::endl
+    << "  global TYPE * restrict c)" << std::endl
+    << "{" << std::endl
+    << "  const size_t i = get_global_id(0);" << std::endl
+    << "  const TYPE s = startScalar;" << std::endl
+    << "  " << code << ";" << std::endl
+    << "}" << std::endl;
+
+  cl::Program program(context, source.str());
+  std::ostringstream args;
+  args << "-DstartScalar=" << startScalar << " ";
+  args << "-DTYPE=" << (sizeof(T) == sizeof(double) ? "double" : "float");
+  try
+  {
+    program.build(args.str().c_str());
+  }
+  catch (cl::Error& err)
+  {
+    if (err.err() == CL_BUILD_PROGRAM_FAILURE)
+    {
+      std::cout << source.str() << std::endl;
+      std::cout << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>()[0].second << std::endl;
+    }
+    throw err;
+  }
+
+  delete expr_kernel;
+  expr_kernel = new cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer>(program, "stream_expr");
+}
+
+template <class T>
+void OCLStream<T>::expr()
+{
+  if (!expr_kernel)
+    throw std::runtime_error("Expression kernel used before init_expr()");
+  (*expr_kernel)(
+    cl::EnqueueArgs(queue, cl::NDRange(array_size)),
+    d_a, d_b, d_c
+  );
+  queue.finish();
+}
+
 template <class T>
 void OCLStream<T>::init_arrays(T initA, T initB, T initC)
 {
@@ -254,6 +702,13 @@ void OCLStream<T>::init_arrays(T initA, T initB, T initC)
   queue.finish();
 }
 
+template <class T>
+bool OCLStream<T>::write_allocate()
+{
+  // CPU devices use ordinary cached stores
+  return (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU) != 0;
+}
+
 template <class T>
 void OCLStream<T>::read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c)
 {
@@ -262,6 +717,235 @@ void OCLStream<T>::read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector
   cl::copy(queue, d_c, c.begin(), c.end());
 }
 
+template <class T>
+void OCLStream<T>::record_replay()
+{
+  // Separate kernel objects, so the functors cannot change their arguments
+  cl::Program program = copy_kernel->getKernel().getInfo<CL_KERNEL_PROGRAM>();
+
+  cl::Kernel copy(program, "copy");
+  copy.setArg(0, d_a);
+  copy.setArg(1, d_c);
+
+  cl::Kernel mul(program, "mul");
+  mul.setArg(0, d_b);
+  mul.setArg(1, d_c);
+
+  cl::Kernel add(program, "add");
+  add.setArg(0, d_a);
+  add.setArg(1, d_b);
+  add.setArg(2, d_c);
+
+  cl::Kernel triad(program, "triad");
+  triad.setArg(0, d_a);
+  triad.setArg(1, d_b);
+  triad.setArg(2, d_c);
+
+  cl::Kernel dot(program, "stream_dot");
+  dot.setArg(0, d_a);
+  dot.setArg(1, d_b);
+  dot.setArg(2, d_sum);
+  dot.setArg(3, cl::Local(sizeof(T) * dot_wgsize));
+  dot.setArg(4, (cl_int)array_size);
+
+  replay_launches = {
+    {copy,  cl::NDRange(array_size), cl::NullRange},
+    {mul,   cl::NDRange(array_size), cl::NullRange},
+    {add,   cl::NDRange(array_size), cl::NullRange},
+    {triad, cl::NDRange(array_size), cl::NullRange},
+    {dot,   cl::NDRange(dot_num_groups*dot_wgsize), cl::NDRange(dot_wgsize)}
+  };
+
+#ifdef cl_khr_command_buffer
+  if (device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_command_buffer") != std::string::npos)
+    record_command_buffer();
+#endif
+  std::cout << "Replaying from " << (replay_command_buffer() ? "a cl_khr_command_buffer" : "a list of enqueued kernels") << std::endl;
+}
+
+#ifdef cl_khr_command_buffer
+template <class T>
+void OCLStream<T>::record_command_buffer()
+{
+  cl_platform_id platform = device.getInfo<CL_DEVICE_PLATFORM>();
+  auto create = (clCreateCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(platform, "clCreateCommandBufferKHR");
+  auto command = (clCommandNDRangeKernelKHR_fn)clGetExtensionFunctionAddressForPlatform(platform, "clCommandNDRangeKernelKHR");
+  auto finalize = (clFinalizeCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(platform, "clFinalizeCommandBufferKHR");
+  enqueue_command_buffer = (clEnqueueCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(platform, "clEnqueueCommandBufferKHR");
+  release_command_buffer = (clReleaseCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(platform, "clReleaseCommandBufferKHR");
+  if (!create || !command || !finalize || !enqueue_command_buffer || !release_command_buffer)
+    return;
+
+  cl_command_queue q = queue();
+  cl_int err;
+  command_buffer = create(1, &q, nullptr, &err);
+  if (err != CL_SUCCESS)
+  {
+    command_buffer = nullptr;
+    return;
+  }
+
+  // Each kernel waits for the one before, as it would on the in-order queue
+  cl_sync_point_khr previous;
+  for (size_t i = 0; i < replay_launches.size() && err == CL_SUCCESS; i++)
+  {
+    const Launch& launch = replay_launches[i];
+    err = command(command_buffer, nullptr, nullptr, launch.kernel(), 1, nullptr,
+      launch.global, launch.local.dimensions() ? (const size_t *)launch.local : nullptr,
+      i > 0 ? 1 : 0, i > 0 ? &previous : nullptr, &previous, nullptr);
+  }
+  if (err == CL_SUCCESS)
+    err = finalize(command_buffer);
+
+  // Fall back to enqueueing the kernels if any part is not supported
+  if (err != CL_SUCCESS)
+  {
+    release_command_buffer(command_buffer);
+    command_buffer = nullptr;
+  }
+}
+#endif
+
+template <class T>
+bool OCLStream<T>::replay_command_buffer()
+{
+#ifdef cl_khr_command_buffer
+  return command_buffer != nullptr;
+#else
+  return false;
+#endif
+}
+
+template <class T>
+T OCLStream<T>::replay()
+{
+  if (replay_launches.empty())
+    record_replay();
+
+#ifdef cl_khr_command_buffer
+  if (command_buffer)
+  {
+    cl_command_queue q = queue();
+    enqueue_command_buffer(1, &q, command_buffer, 0, nullptr, nullptr);
+  }
+  else
+#endif
+  for (Launch& launch : replay_launches)
+    queue.enqueueNDRangeKernel(launch.kernel, cl::NullRange, launch.global, launch.local);
+  queue.enqueueReadBuffer(d_sum, CL_FALSE, 0, sizeof(T) * dot_num_groups, sums.data());
+  queue.finish();
+
+  T sum = 0.0;
+  for (T val : sums)
+    sum += val;
+
+  return sum;
+}
+
+template <class T>
+void OCLStream<T>::init_transfers()
+{
+  const size_t bytes = sizeof(T) * array_size;
+
+  transfer_queue = cl::CommandQueue(context);
+
+  for (int i = 0; i < 2; i++)
+  {
+    h_pageable[i] = std::vector<char>(bytes);
+
+    // Pinned host memory is only available by mapping a host allocated buffer
+    h_pinned[i] = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+    h_pinned_ptr[i] = queue.enqueueMapBuffer(h_pinned[i], CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes);
+  }
+}
+
+template <class T>
+void OCLStream<T>::transfer(Transfer dir, bool pinned, size_t bytes)
+{
+  if (bytes > sizeof(T) * array_size)
+    throw std::runtime_error("Transfer is larger than the device buffers");
+
+  if (!h_pinned_ptr[0])
+    init_transfers();
+
+  void *upload = pinned ? h_pinned_ptr[0] : h_pageable[0].data();
+  void *download = pinned ? h_pinned_ptr[1] : h_pageable[1].data();
+
+  switch (dir)
+  {
+    case Transfer::HostToDevice:
+      queue.enqueueWriteBuffer(d_a, CL_FALSE, 0, bytes, upload);
+      break;
+    case Transfer::DeviceToHost:
+      queue.enqueueReadBuffer(d_b, CL_FALSE, 0, bytes, download);
+      break;
+    case Transfer::DeviceToDevice:
+      queue.enqueueCopyBuffer(d_a, d_c, 0, 0, bytes);
+      break;
+    case Transfer::Bidirectional:
+      queue.enqueueWriteBuffer(d_a, CL_FALSE, 0, bytes, upload);
+      transfer_queue.enqueueReadBuffer(d_b, CL_FALSE, 0, bytes, download);
+      // Submit both before waiting, or the upload may only start once the
+      // download has finished
+      queue.flush();
+      transfer_queue.flush();
+      transfer_queue.finish();
+      break;
+  }
+  queue.finish();
+}
+
+template <class T>
+void OCLStream<T>::pipeline_triad(std::vector<T>& a, const std::vector<T>& b, const std::vector<T>& c)
+{
+  if (!upload_queue())
+  {
+    upload_queue = cl::CommandQueue(context);
+    download_queue = cl::CommandQueue(context);
+  }
+
+  // Each slot is a chunk sized region of the device arrays
+  const size_t chunk = array_size / PIPELINE_SLOTS;
+  const size_t num_chunks = (a.size() + chunk - 1) / chunk;
+
+  std::vector<cl::Event> uploaded(num_chunks);
+  std::vector<cl::Event> computed(num_chunks);
+  std::vector<cl::Event> downloaded(num_chunks);
+
+  for (size_t i = 0; i < num_chunks; i++)
+  {
+    const size_t slot = (i % PIPELINE_SLOTS) * chunk;
+    const size_t offset = i * chunk;
+    const size_t count = std::min(chunk, a.size() - offset);
+
+    // Reuse the slot once its previous chunk has drained back to the host
+    std::vector<cl::Event> wait;
+    if (i >= PIPELINE_SLOTS)
+      wait.push_back(downloaded[i - PIPELINE_SLOTS]);
+
+    upload_queue.enqueueWriteBuffer(d_b, CL_FALSE, slot * sizeof(T), count * sizeof(T), b.data() + offset, &wait);
+    upload_queue.enqueueWriteBuffer(d_c, CL_FALSE, slot * sizeof(T), count * sizeof(T), c.data() + offset, nullptr, &uploaded[i]);
+
+    // Run over the slot by offsetting the global IDs
+    computed[i] = (*triad_kernel)(
+      cl::EnqueueArgs(queue, uploaded[i], cl::NDRange(slot), cl::NDRange(count), cl::NullRange),
+      d_a, d_b, d_c
+    );
+
+    wait.assign(1, computed[i]);
+    download_queue.enqueueReadBuffer(d_a, CL_FALSE, slot * sizeof(T), count * sizeof(T), a.data() + offset, &wait, &downloaded[i]);
+
+    // Start the work as soon as it is enqueued
+    upload_queue.flush();
+    queue.flush();
+    download_queue.flush();
+  }
+
+  upload_queue.finish();
+  queue.finish();
+  download_queue.finish();
+}
+
 void getDeviceList(void)
 {
   // Get list of platforms
@@ -278,6 +962,33 @@ void getDeviceList(void)
   cached = true;
 }
 
+cl::Device getDevice(const int device_index)
+{
+  if (!cached)
+    getDeviceList();
+
+  // Setup default OpenCL GPU
+  if (device_index >= devices.size())
+    throw std::runtime_error("Invalid device index");
+  return devices[device_index];
+}
+
+std::vector<cl::Device> getNUMADevices(const int device_index)
+{
+  cl::Device device = getDevice(device_index);
+
+  if (!(device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>() & CL_DEVICE_AFFINITY_DOMAIN_NUMA))
+    throw std::runtime_error("Device cannot be partitioned by NUMA domain");
+
+  const cl_device_partition_property properties[] = {
+    CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0
+  };
+  std::vector<cl::Device> sub_devices;
+  device.createSubDevices(properties, &sub_devices);
+
+  return sub_devices;
+}
+
 void listDevices(void)
 {
   getDeviceList();
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <iostream>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
 
@@ -21,6 +22,9 @@
 
 #define IMPLEMENTATION_STRING "OpenCL"
 
+// Row length of the 2D images used by the image kernels
+#define IMAGE_WIDTH 4096
+
 template <class T>
 class OCLStream : public Stream<T>
 {
@@ -36,6 +40,11 @@ class OCLStream : public Stream<T>
     cl::Buffer d_b;
     cl::Buffer d_c;
     cl::Buffer d_sum;
+    cl::Buffer d_result;
+
+    // Pinned host copy of the fully reduced dot result
+    cl::Buffer h_result;
+    T *h_result_ptr;
 
     // OpenCL objects
     cl::Device device;
@@ -48,14 +57,84 @@ class OCLStream : public Stream<T>
     cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer> *add_kernel;
     cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer> *triad_kernel;
     cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl::LocalSpaceArg, cl_int> *dot_kernel;
+    cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::LocalSpaceArg, cl_int> *dot_final_kernel;
+    cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int> *local_copy_kernel;
+    cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int, cl_int> *local_stride_kernel;
+    cl::KernelFunctor<cl::Buffer, cl::LocalSpaceArg, cl_int> *local_broadcast_kernel;
+
+    // Per work-item results of the local memory kernels, keeping them live
+    cl::Buffer d_local;
+    size_t local_size = 0;
 
     // NDRange configuration for the dot kernel
     size_t dot_num_groups;
     size_t dot_wgsize;
 
+    // The streaming kernels are split into partitions launched round robin
+    // onto these queues: either several in-order queues or one out-of-order queue
+    unsigned int num_partitions = 1;
+    std::vector<cl::CommandQueue> partition_queues;
+
+    cl::EnqueueArgs partition_args(unsigned int p);
+    void finish_partitions();
+
+    // Kernel sequence for replay, with arguments set once when recorded
+    struct Launch
+    {
+      cl::Kernel kernel;
+      cl::NDRange global;
+      cl::NDRange local;
+    };
+    std::vector<Launch> replay_launches;
+
+#ifdef cl_khr_command_buffer
+    // The same sequence recorded once, where the device supports
+    // cl_khr_command_buffer; otherwise the launches are enqueued each time
+    cl_command_buffer_khr command_buffer = nullptr;
+    clEnqueueCommandBufferKHR_fn enqueue_command_buffer = nullptr;
+    clReleaseCommandBufferKHR_fn release_command_buffer = nullptr;
+
+    void record_command_buffer();
+#endif
+
+    void record_replay();
+    bool replay_command_buffer();
+
+    // Images for the texture path kernels, created by init_images()
+    // Index 0, 1 and 2 hold a, b and c; linear images are views of buffers
+    cl::Program image_program;
+    cl::Image2D d_image2d[3];
+    cl::Image1DBuffer d_image1d[3];
+    cl::Buffer d_image_store[3];
+    cl::Kernel image_copy_kernel;
+    cl::Kernel image_triad_kernel;
+    cl::NDRange image_range;
+    cl::array<size_t, 3> image_region;
+    bool image_linear;
+    bool image_half;
+
+    // Kernel generated by init_expr()
+    cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer> *expr_kernel = nullptr;
+
+    // Host staging for the transfer benchmark, allocated on first use
+    // Index 0 is uploaded from and index 1 is downloaded into
+    std::vector<char> h_pageable[2];
+    cl::Buffer h_pinned[2];
+    void *h_pinned_ptr[2] = {nullptr, nullptr};
+
+    // Second queue so uploads and downloads can run concurrently
+    cl::CommandQueue transfer_queue;
+
+    void init_transfers();
+
+    // Queues feeding and draining the pipelined Triad, created on first use
+    cl::CommandQueue upload_queue;
+    cl::CommandQueue download_queue;
+
   public:
 
     OCLStream(const unsigned int, const int);
+    OCLStream(const unsigned int, const cl::Device&);
     ~OCLStream();
 
     virtual void copy() override;
@@ -67,7 +146,24 @@ class OCLStream : public Stream<T>
     virtual void init_arrays(T initA, T initB, T initC) override;
     virtual void read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) override;
 
+    virtual void transfer(Transfer dir, bool pinned, size_t bytes) override;
+    virtual void set_partitions(unsigned int count, bool out_of_order) override;
+    virtual T replay() override;
+    virtual T dot_on_device() override;
+    virtual size_t init_images(bool linear, bool half) override;
+    virtual void image_copy() override;
+    virtual void image_triad() override;
+    virtual void read_images(std::vector<float>& a, std::vector<float>& b, std::vector<float>& c) override;
+    virtual bool write_allocate() override;
+    virtual size_t local_bandwidth(LocalAccess pattern, unsigned int wgsize, unsigned int repeats, unsigned int stride) override;
+    virtual void init_expr(const std::string& code) override;
+    virtual void expr() override;
+    virtual void pipeline_triad(std::vector<T>& a, const std::vector<T>& b, const std::vector<T>& c) override;
+
 };
 
 // Populate the devices list
 void getDeviceList(void);
+
+// Partition a device into one sub-device per NUMA domain
+std::vector<cl::Device> getNUMADevices(const int);
@@ -7,10 +7,23 @@
 
 #include "OMPStream.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cmath>
+
+#ifndef OMP_TARGET_GPU
+#include <sys/mman.h>
+#endif
+
 #ifndef ALIGNMENT
 #define ALIGNMENT (2*1024*1024) // 2MB
 #endif
 
+// Elements of Triad between pauses in the loaded latency benchmark
+#define LOADED_CHUNK 16384
+
 template <class T>
 OMPStream<T>::OMPStream(const unsigned int ARRAY_SIZE, T *a, T *b, T *c, int device)
 {
@@ -47,6 +60,7 @@ OMPStream<T>::~OMPStream()
   free(a);
   free(b);
   free(c);
+  free(chase_buffer);
 #endif
 }
 
@@ -90,6 +104,157 @@ void OMPStream<T>::read_arrays(std::vector<T>& h_a, std::vector<T>& h_b, std::ve
 #endif
 }
 
+template <class T>
+bool OMPStream<T>::write_allocate()
+{
+#if defined(OMP_TARGET_GPU) || defined(STREAMING_STORES)
+  return false;
+#else
+  return true;
+#endif
+}
+
+#ifndef OMP_TARGET_GPU
+template <class T>
+void OMPStream<T>::host_arrays(T **a, T **b, T **c)
+{
+  *a = this->a;
+  *b = this->b;
+  *c = this->c;
+}
+
+template <class T>
+bool OMPStream<T>::set_repetitions(unsigned int reps)
+{
+  repetitions = reps;
+  return true;
+}
+
+template <class T>
+void OMPStream<T>::init_chase(size_t bytes, bool huge_pages, bool within_pages)
+{
+  if (bytes < CHASE_PAGE)
+    throw std::runtime_error("Latency working set must be at least one page");
+
+  // Allocate as for the arrays, whole pages only so the page size is not
+  // mixed within the working set
+  free(chase_buffer);
+  const size_t size = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  chase_buffer = (char*)aligned_alloc(ALIGNMENT, size);
+  if (!chase_buffer)
+    throw std::runtime_error("Could not allocate the latency working set");
+
+  // Must be set before the pages are first touched
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+  madvise(chase_buffer, size, huge_pages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+
+  // Order in which the lines are visited
+  const size_t lines = bytes / CHASE_LINE;
+  const size_t lines_per_page = CHASE_PAGE / CHASE_LINE;
+  std::vector<size_t> order(lines);
+  for (size_t i = 0; i < lines; i++)
+    order[i] = i;
+
+  std::mt19937_64 rng(lines);
+  if (within_pages)
+  {
+    // Pages in a random order, with the lines of each page shuffled
+    const size_t pages = lines / lines_per_page;
+    std::vector<size_t> page_order(pages);
+    for (size_t p = 0; p < pages; p++)
+      page_order[p] = p;
+    std::shuffle(page_order.begin(), page_order.end(), rng);
+    for (size_t p = 0; p < pages; p++)
+    {
+      for (size_t l = 0; l < lines_per_page; l++)
+        order[p * lines_per_page + l] = page_order[p] * lines_per_page + l;
+      std::shuffle(order.begin() + p * lines_per_page, order.begin() + (p + 1) * lines_per_page, rng);
+    }
+  }
+  else
+  {
+    std::shuffle(order.begin(), order.end(), rng);
+  }
+
+  // Link the lines into a single cycle
+  for (size_t i = 0; i < lines; i++)
+  {
+    void **line = (void**)(chase_buffer + order[i] * CHASE_LINE);
+    *line = chase_buffer + order[(i + 1) % lines] * CHASE_LINE;
+  }
+  chase_position = (void**)(chase_buffer + order[0] * CHASE_LINE);
+}
+
+template <class T>
+void OMPStream<T>::chase(size_t loads)
+{
+  void **p = chase_position;
+  for (size_t i = 0; i < loads; i++)
+    p = (void**)*p;
+
+  // Storing the position keeps the loads live
+  chase_position = p;
+}
+
+template <class T>
+size_t OMPStream<T>::loaded_chase(size_t loads, double rate)
+{
+  if (omp_get_max_threads() < 2)
+    throw std::runtime_error("Loaded latency needs at least two threads");
+
+  const T scalar = startScalar;
+  std::atomic<bool> done(false);
+  size_t bytes = 0;
+
+  #pragma omp parallel reduction(+:bytes)
+  {
+    const int thread = omp_get_thread_num();
+    const int loaders = omp_get_num_threads() - 1;
+
+    if (thread == 0)
+    {
+      chase(loads);
+      done = true;
+    }
+    else if (rate > 0.0)
+    {
+      // Each loading thread streams over its own slice of the arrays, at
+      // its share of the rate
+      const size_t begin = (size_t)array_size * (thread - 1) / loaders;
+      const size_t end = (size_t)array_size * thread / loaders;
+      const double thread_rate = rate / loaders;
+      size_t i = begin;
+      size_t moved = 0;
+
+      auto start = std::chrono::high_resolution_clock::now();
+      while (!done && begin < end)
+      {
+        const size_t n = std::min<size_t>(LOADED_CHUNK, end - i);
+
+        #pragma omp simd
+        for (size_t j = i; j < i + n; j++)
+          a[j] = b[j] + scalar * c[j];
+
+        moved += 3 * sizeof(T) * n;
+        i = (i + n == end) ? begin : i + n;
+
+        // Idle until the bytes moved so far are on schedule for the rate
+        if (std::isfinite(thread_rate))
+        {
+          auto until = start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+            std::chrono::duration<double>(moved / thread_rate));
+          while (!done && std::chrono::high_resolution_clock::now() < until);
+        }
+      }
+      bytes += moved;
+    }
+  }
+
+  return bytes;
+}
+#endif
+
 template <class T>
 void OMPStream<T>::copy()
 {
@@ -99,7 +264,9 @@ void OMPStream<T>::copy()
   T *c = this->c;
   #pragma omp target teams distribute parallel for simd map(to: a[0:array_size], c[0:array_size])
 #else
-  #pragma omp parallel for
+  #pragma omp parallel
+  for (unsigned int r = 0; r < repetitions; r++)
+  #pragma omp for
 #endif
   for (int i = 0; i < array_size; i++)
   {
@@ -118,7 +285,9 @@ void OMPStream<T>::mul()
   T *c = this->c;
   #pragma omp target teams distribute parallel for simd map(to: b[0:array_size], c[0:array_size])
 #else
-  #pragma omp parallel for
+  #pragma omp parallel
+  for (unsigned int r = 0; r < repetitions; r++)
+  #pragma omp for
 #endif
   for (int i = 0; i < array_size; i++)
   {
@@ -136,7 +305,9 @@ void OMPStream<T>::add()
   T *c = this->c;
   #pragma omp target teams distribute parallel for simd map(to: a[0:array_size], b[0:array_size], c[0:array_size])
 #else
-  #pragma omp parallel for
+  #pragma omp parallel
+  for (unsigned int r = 0; r < repetitions; r++)
+  #pragma omp for
 #endif
   for (int i = 0; i < array_size; i++)
   {
@@ -156,7 +327,9 @@ void OMPStream<T>::triad()
   T *c = this->c;
   #pragma omp target teams distribute parallel for simd map(to: a[0:array_size], b[0:array_size], c[0:array_size])
 #else
-  #pragma omp parallel for
+  #pragma omp parallel
+  for (unsigned int r = 0; r < repetitions; r++)
+  #pragma omp for
 #endif
   for (int i = 0; i < array_size; i++)
   {
@@ -164,6 +337,52 @@ void OMPStream<T>::triad()
   }
 }
 
+template <class T, unsigned int FMAS>
+void intensity_kernel(T *a, T *b, T *c, unsigned int array_size)
+{
+  const T scalar = startScalar;
+  const unsigned int chains = FMAS < INTENSITY_CHAINS ? FMAS : INTENSITY_CHAINS;
+
+#ifdef OMP_TARGET_GPU
+  #pragma omp target teams distribute parallel for simd map(to: a[0:array_size], b[0:array_size], c[0:array_size])
+#else
+  #pragma omp parallel for simd
+#endif
+  for (int i = 0; i < array_size; i++)
+  {
+    T x[chains];
+    for (unsigned int j = 0; j < chains; j++)
+      x[j] = b[i] + j;
+    for (unsigned int f = 0; f < FMAS / chains; f++)
+      for (unsigned int j = 0; j < chains; j++)
+        x[j] = x[j] * scalar + c[i];
+    T sum = x[0];
+    for (unsigned int j = 1; j < chains; j++)
+      sum += x[j];
+    a[i] = sum;
+  }
+}
+
+template <class T>
+void OMPStream<T>::intensity_triad(unsigned int fmas)
+{
+  switch (fmas)
+  {
+    case 1:   intensity_kernel<T, 1>(a, b, c, array_size);   break;
+    case 2:   intensity_kernel<T, 2>(a, b, c, array_size);   break;
+    case 4:   intensity_kernel<T, 4>(a, b, c, array_size);   break;
+    case 8:   intensity_kernel<T, 8>(a, b, c, array_size);   break;
+    case 16:  intensity_kernel<T, 16>(a, b, c, array_size);  break;
+    case 32:  intensity_kernel<T, 32>(a, b, c, array_size);  break;
+    case 64:  intensity_kernel<T, 64>(a, b, c, array_size);  break;
+    case 128: intensity_kernel<T, 128>(a, b, c, array_size); break;
+    case 256: intensity_kernel<T, 256>(a, b, c, array_size); break;
+    case 512: intensity_kernel<T, 512>(a, b, c, array_size); break;
+    default:
+      throw std::runtime_error("FMAs per element must be a power of two up to 512");
+  }
+}
+
 template <class T>
 T OMPStream<T>::dot()
 {
@@ -174,13 +393,25 @@ T OMPStream<T>::dot()
   T *a = this->a;
   T *b = this->b;
   #pragma omp target teams distribute parallel for simd reduction(+:sum) map(tofrom: sum)
-#else
-  #pragma omp parallel for reduction(+:sum)
-#endif
   for (int i = 0; i < array_size; i++)
   {
     sum += a[i] * b[i];
   }
+#else
+  // Each repetition starts the sum again, so the result is rounded as
+  // for a single reduction
+  #pragma omp parallel
+  for (unsigned int r = 0; r < repetitions; r++)
+  {
+    #pragma omp single
+    sum = 0.0;
+    #pragma omp for reduction(+:sum)
+    for (int i = 0; i < array_size; i++)
+    {
+      sum += a[i] * b[i];
+    }
+  }
+#endif
 
   return sum;
 }
@@ -28,6 +28,13 @@ class OMPStream : public Stream<T>
     T *b;
     T *c;
 
+    // Times each kernel repeats within one parallel region
+    unsigned int repetitions = 1;
+
+    // Pointer chasing chain and the current position in it
+    char *chase_buffer = nullptr;
+    void **chase_position = nullptr;
+
   public:
     OMPStream(const unsigned int, T*, T*, T*, int);
     ~OMPStream();
@@ -41,6 +48,17 @@ class OMPStream : public Stream<T>
     virtual void init_arrays(T initA, T initB, T initC) override;
     virtual void read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) override;
 
+    virtual void intensity_triad(unsigned int fmas) override;
+    virtual bool write_allocate() override;
+
+#ifndef OMP_TARGET_GPU
+    virtual void host_arrays(T **a, T **b, T **c) override;
+    virtual bool set_repetitions(unsigned int reps) override;
+    virtual void init_chase(size_t bytes, bool huge_pages, bool within_pages) override;
+    virtual void chase(size_t loads) override;
+    virtual size_t loaded_chase(size_t loads, double rate) override;
+#endif
+
 
 
 };
@@ -70,6 +70,26 @@ void RAJAStream<T>::read_arrays(
   std::copy(d_c, d_c + array_size, c.data());
 }
 
+template <class T>
+bool RAJAStream<T>::write_allocate()
+{
+#if defined(RAJA_TARGET_CPU) && !defined(STREAMING_STORES)
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef RAJA_TARGET_CPU
+template <class T>
+void RAJAStream<T>::host_arrays(T **a, T **b, T **c)
+{
+  *a = d_a;
+  *b = d_b;
+  *c = d_c;
+}
+#endif
+
 template <class T>
 void RAJAStream<T>::copy()
 {
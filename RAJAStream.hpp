@@ -56,5 +56,11 @@ class RAJAStream : public Stream<T>
     virtual void init_arrays(T initA, T initB, T initC) override;
     virtual void read_arrays(
             std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) override;
+
+    virtual bool write_allocate() override;
+
+#ifdef RAJA_TARGET_CPU
+    virtual void host_arrays(T **a, T **b, T **c) override;
+#endif
 };
 
@@ -57,6 +57,9 @@ SYCLStream<T>::SYCLStream(const unsigned int ARRAY_SIZE, const int device_index)
   p->build_from_kernel_name<add_kernel>();
   p->build_from_kernel_name<triad_kernel>();
   p->build_from_kernel_name<dot_kernel>();
+  p->build_from_kernel_name<local_copy_kernel>();
+  p->build_from_kernel_name<local_stride_kernel>();
+  p->build_from_kernel_name<local_broadcast_kernel>();
 
   // Create buffers
   d_a = new buffer<T>(array_size);
@@ -72,6 +75,7 @@ SYCLStream<T>::~SYCLStream()
   delete d_b;
   delete d_c;
   delete d_sum;
+  delete d_local;
 
   delete p;
   delete queue;
@@ -196,6 +200,106 @@ T SYCLStream<T>::dot()
   return sum;
 }
 
+template <class T>
+size_t SYCLStream<T>::local_bandwidth(LocalAccess pattern, unsigned int wgsize, unsigned int repeats, unsigned int stride)
+{
+  const size_t n = wgsize * LOCAL_ELEMENTS;
+  if (wgsize == 0 || (wgsize & (wgsize - 1)))
+    throw std::runtime_error("Work-group size must be a power of two");
+
+  device dev = queue->get_device();
+  if (wgsize > dev.get_info<info::device::max_work_group_size>())
+    throw std::runtime_error("Work-group size is too large for the device");
+  if (2 * n * sizeof(T) > dev.get_info<info::device::local_mem_size>())
+    throw std::runtime_error("Device does not have enough local memory for the work-group size");
+
+  // Enough work-groups to occupy the device, as for the dot kernel
+  const size_t global = dot_num_groups * wgsize;
+  if (!d_local || d_local->get_count() != global)
+  {
+    delete d_local;
+    d_local = new buffer<T>(global);
+  }
+
+  const int R = repeats;
+  const int S = stride;
+
+  queue->submit([&](handler &cgh)
+  {
+    auto kout = d_local->template get_access<access::mode::write>(cgh);
+
+    if (pattern == LocalAccess::Copy)
+    {
+      auto scratch = accessor<T, 1, access::mode::read_write, access::target::local>(range<1>(2 * n), cgh);
+      cgh.parallel_for<local_copy_kernel>(p->get_kernel<local_copy_kernel>(),
+        nd_range<1>(global, wgsize), [=](nd_item<1> item)
+      {
+        size_t li = item.get_local(0);
+        for (size_t j = li; j < n; j += wgsize)
+          scratch[j] = j;
+        item.barrier(access::fence_space::local_space);
+
+        // Copy between the two halves of scratch, shifted by one element so
+        // that every pass depends on the writes of other work-items
+        for (int r = 0; r < R; r++)
+        {
+          const size_t src = (r & 1) * n;
+          const size_t dst = n - src;
+          for (size_t j = li; j < n; j += wgsize)
+            scratch[dst + j] = scratch[src + ((j + 1) & (n - 1))];
+          item.barrier(access::fence_space::local_space);
+        }
+
+        kout[item.get_global(0)] = scratch[(R & 1) * n + li];
+      });
+    }
+    else if (pattern == LocalAccess::Stride)
+    {
+      auto scratch = accessor<T, 1, access::mode::read_write, access::target::local>(range<1>(n), cgh);
+      cgh.parallel_for<local_stride_kernel>(p->get_kernel<local_stride_kernel>(),
+        nd_range<1>(global, wgsize), [=](nd_item<1> item)
+      {
+        size_t li = item.get_local(0);
+        for (size_t j = li; j < n; j += wgsize)
+          scratch[j] = j;
+        item.barrier(access::fence_space::local_space);
+
+        T sum = 0.0;
+        for (int r = 0; r < R; r++)
+          for (size_t j = li; j < n; j += wgsize)
+            sum += scratch[(j * S + r) & (n - 1)];
+
+        kout[item.get_global(0)] = sum;
+      });
+    }
+    else
+    {
+      auto scratch = accessor<T, 1, access::mode::read_write, access::target::local>(range<1>(n), cgh);
+      cgh.parallel_for<local_broadcast_kernel>(p->get_kernel<local_broadcast_kernel>(),
+        nd_range<1>(global, wgsize), [=](nd_item<1> item)
+      {
+        size_t li = item.get_local(0);
+        for (size_t j = li; j < n; j += wgsize)
+          scratch[j] = j;
+        item.barrier(access::fence_space::local_space);
+
+        T sum = 0.0;
+        for (int r = 0; r < R; r++)
+          for (int e = 0; e < LOCAL_ELEMENTS; e++)
+            sum += scratch[(r * LOCAL_ELEMENTS + e) & (n - 1)];
+
+        kout[item.get_global(0)] = sum;
+      });
+    }
+  });
+  queue->wait();
+
+  size_t accessed = dot_num_groups * n * repeats * sizeof(T);
+  if (pattern == LocalAccess::Copy)
+    accessed *= 2;
+  return accessed;
+}
+
 template <class T>
 void SYCLStream<T>::init_arrays(T initA, T initB, T initC)
 {
@@ -216,6 +320,13 @@ void SYCLStream<T>::init_arrays(T initA, T initB, T initC)
   queue->wait();
 }
 
+template <class T>
+bool SYCLStream<T>::write_allocate()
+{
+  // CPU devices use ordinary cached stores
+  return queue->get_device().is_cpu();
+}
+
 template <class T>
 void SYCLStream<T>::read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c)
 {
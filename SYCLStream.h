@@ -23,6 +23,9 @@ namespace sycl_kernels
   template <class T> class add;
   template <class T> class triad;
   template <class T> class dot;
+  template <class T> class local_copy;
+  template <class T> class local_stride;
+  template <class T> class local_broadcast;
 }
 
 template <class T>
@@ -39,6 +42,9 @@ class SYCLStream : public Stream<T>
     cl::sycl::buffer<T> *d_c;
     cl::sycl::buffer<T> *d_sum;
 
+    // Per work-item results of the local memory kernels, keeping them live
+    cl::sycl::buffer<T> *d_local = nullptr;
+
     // SYCL kernel names
     typedef sycl_kernels::init<T> init_kernel;
     typedef sycl_kernels::copy<T> copy_kernel;
@@ -46,6 +52,9 @@ class SYCLStream : public Stream<T>
     typedef sycl_kernels::add<T> add_kernel;
     typedef sycl_kernels::triad<T> triad_kernel;
     typedef sycl_kernels::dot<T> dot_kernel;
+    typedef sycl_kernels::local_copy<T> local_copy_kernel;
+    typedef sycl_kernels::local_stride<T> local_stride_kernel;
+    typedef sycl_kernels::local_broadcast<T> local_broadcast_kernel;
 
     // NDRange configuration for the dot kernel
     size_t dot_num_groups;
@@ -65,6 +74,9 @@ class SYCLStream : public Stream<T>
     virtual void init_arrays(T initA, T initB, T initC) override;
     virtual void read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) override;
 
+    virtual bool write_allocate() override;
+    virtual size_t local_bandwidth(LocalAccess pattern, unsigned int wgsize, unsigned int repeats, unsigned int stride) override;
+
 };
 
 // Populate the devices list
@@ -0,0 +1,106 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+// Count, mean, variance and range of a stream of samples in constant space,
+// using Welford's update so long runs do not lose precision
+class RollingStats
+{
+  protected:
+    unsigned long n = 0;
+    double m = 0.0;
+    double m2 = 0.0;
+    double lo = std::numeric_limits<double>::max();
+    double hi = std::numeric_limits<double>::lowest();
+    double latest = 0.0;
+
+  public:
+
+    void add(const double x)
+    {
+      n++;
+      const double delta = x - m;
+      m += delta / n;
+      m2 += delta * (x - m);
+      lo = std::min(lo, x);
+      hi = std::max(hi, x);
+      latest = x;
+    }
+
+    unsigned long count() const { return n; }
+    double mean() const { return m; }
+    double min() const { return lo; }
+    double max() const { return hi; }
+    double last() const { return latest; }
+
+    // Sample standard deviation
+    double stddev() const
+    {
+      return n > 1 ? std::sqrt(m2 / (n - 1)) : 0.0;
+    }
+};
+
+// Least squares line through (x, y), with the standard error of the slope
+struct LinearFit
+{
+  double slope;
+  double intercept;
+  double slope_error;
+};
+
+inline LinearFit linear_fit(const std::vector<double>& x, const std::vector<double>& y)
+{
+  const size_t n = x.size();
+  double mx = 0.0, my = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    mx += x[i] / n;
+    my += y[i] / n;
+  }
+
+  double sxx = 0.0, sxy = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    sxx += (x[i] - mx) * (x[i] - mx);
+    sxy += (x[i] - mx) * (y[i] - my);
+  }
+
+  LinearFit fit;
+  fit.slope = sxx > 0.0 ? sxy / sxx : 0.0;
+  fit.intercept = my - fit.slope * mx;
+
+  double sse = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    const double r = y[i] - fit.intercept - fit.slope * x[i];
+    sse += r * r;
+  }
+  fit.slope_error = n > 2 && sxx > 0.0 ? std::sqrt(sse / (n - 2) / sxx) : 0.0;
+  return fit;
+}
+
+// Two sided 95% critical value of Student's t distribution
+inline double t_critical(const size_t df)
+{
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  if (df == 0)
+    return std::numeric_limits<double>::infinity();
+  if (df <= 30)
+    return table[df - 1];
+  return df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
+
@@ -9,6 +9,7 @@
 
 #include <vector>
 #include <string>
+#include <stdexcept>
 
 // Array values
 #define startA (0.1)
@@ -16,6 +17,39 @@
 #define startC (0.0)
 #define startScalar (0.4)
 
+// Directions for the host/device transfer benchmark
+enum class Transfer
+{
+  HostToDevice,
+  DeviceToHost,
+  DeviceToDevice,
+  Bidirectional // Concurrent host to device and device to host
+};
+
+// Number of chunks in flight in the pipelined Triad: one uploading,
+// one computing and one downloading
+#define PIPELINE_SLOTS 3
+
+// Access patterns for the local memory benchmark
+enum class LocalAccess
+{
+  Copy,     // Copy between two local arrays
+  Stride,   // Strided reads, exposing bank conflicts
+  Broadcast // Every work-item reads the same element
+};
+
+// Elements per work-item staged in local memory
+#define LOCAL_ELEMENTS 4
+
+// Cache line and page size used to lay out the pointer chasing chain
+#define CHASE_LINE 64
+#define CHASE_PAGE 4096
+
+// Largest number of FMAs per element in the arithmetic intensity Triad,
+// and the number of independent dependency chains they are spread over
+#define INTENSITY_MAX_FMAS 512
+#define INTENSITY_CHAINS 8
+
 template <class T>
 class Stream
 {
@@ -35,6 +69,145 @@ class Stream
     virtual void init_arrays(T initA, T initB, T initC) = 0;
     virtual void read_arrays(std::vector<T>& a, std::vector<T>& b, std::vector<T>& c) = 0;
 
+    // Optional benchmarks
+    // Implementations which do not support these throw
+    // These must be blocking calls
+
+    // Move bytes between host and device (or within the device), staging
+    // host data in either pinned or pageable memory
+    virtual void transfer(Transfer dir, bool pinned, size_t bytes)
+    {
+      throw std::runtime_error("Transfer benchmark not supported by this implementation");
+    }
+
+    // Triad over host resident arrays of any length, streamed through the
+    // device arrays in PIPELINE_SLOTS chunks so transfers overlap with compute
+    virtual void pipeline_triad(std::vector<T>& a, const std::vector<T>& b, const std::vector<T>& c)
+    {
+      throw std::runtime_error("Pipeline benchmark not supported by this implementation");
+    }
+
+    // Split Copy, Mul, Add and Triad into count disjoint partitions launched
+    // concurrently, either on separate queues or on one out-of-order queue
+    virtual void set_partitions(unsigned int count, bool out_of_order)
+    {
+      throw std::runtime_error("Concurrent partitions not supported by this implementation");
+    }
+
+    // Run Copy, Mul, Add, Triad and Dot in turn from a sequence recorded on
+    // the first call, waiting only once at the end; returns the Dot result
+    virtual T replay()
+    {
+      throw std::runtime_error("Kernel replay not supported by this implementation");
+    }
+
+    // Dot with the partial sums also reduced on the device, so that only
+    // the final value is copied back to the host
+    virtual T dot_on_device()
+    {
+      throw std::runtime_error("On-device Dot reduction not supported by this implementation");
+    }
+
+    // Copy and Triad read through the image (texture) path instead of
+    // from buffers. init_images() creates RGBA images with 32 or 16 bit
+    // float channels, in a linear or implementation tiled layout, and
+    // returns the size of each image in bytes
+    virtual size_t init_images(bool linear, bool half)
+    {
+      throw std::runtime_error("Image kernels not supported by this implementation");
+    }
+    virtual void image_copy()
+    {
+      throw std::runtime_error("Image kernels not supported by this implementation");
+    }
+    virtual void image_triad()
+    {
+      throw std::runtime_error("Image kernels not supported by this implementation");
+    }
+    virtual void read_images(std::vector<float>& a, std::vector<float>& b, std::vector<float>& c)
+    {
+      throw std::runtime_error("Image kernels not supported by this implementation");
+    }
+
+    // On-chip local (shared) memory bandwidth: each work-group of wgsize
+    // work-items stages LOCAL_ELEMENTS elements per work-item in local
+    // memory and accesses them repeats times. Returns the bytes of local
+    // memory accessed
+    virtual size_t local_bandwidth(LocalAccess pattern, unsigned int wgsize, unsigned int repeats, unsigned int stride)
+    {
+      throw std::runtime_error("Local memory benchmark not supported by this implementation");
+    }
+
+    // Elementwise kernel generated at runtime from code, a C statement
+    // assigning element i of one of the arrays a, b or c from those arrays,
+    // the scalar s and constants of type TYPE. Run with expr()
+    virtual void init_expr(const std::string& code)
+    {
+      throw std::runtime_error("Expression kernels not supported by this implementation");
+    }
+    virtual void expr()
+    {
+      throw std::runtime_error("Expression kernels not supported by this implementation");
+    }
+
+    // Triad variant a[i] = f(b[i], c[i]) doing fmas fused multiply-adds per
+    // element, for fmas a power of two up to INTENSITY_MAX_FMAS. Chain j
+    // starts at b[i] + j and repeats x = x * scalar + c[i]; a[i] is the sum
+    // of up to INTENSITY_CHAINS chains
+    virtual void intensity_triad(unsigned int fmas)
+    {
+      throw std::runtime_error("Arithmetic intensity benchmark not supported by this implementation");
+    }
+
+    // Pointer chasing latency over a working set of bytes, with one pointer
+    // per cache line linked in a random cycle. The cycle either jumps
+    // between pages at random or visits every line of a page before moving
+    // to the next. The set is backed by huge pages or by 4K pages
+    virtual void init_chase(size_t bytes, bool huge_pages, bool within_pages)
+    {
+      throw std::runtime_error("Latency benchmark not supported by this implementation");
+    }
+
+    // Follow the chain for loads dependent loads from a single thread,
+    // carrying on from where the last call finished
+    virtual void chase(size_t loads)
+    {
+      throw std::runtime_error("Latency benchmark not supported by this implementation");
+    }
+
+    // Follow the chain from init_chase() for loads loads from one thread,
+    // while the other threads run Triad in chunks, idling after each chunk
+    // to hold Triad to rate bytes/sec in total (0 for no load, infinity for
+    // unthrottled). Returns the bytes moved by Triad while the chain was
+    // followed
+    virtual size_t loaded_chase(size_t loads, double rate)
+    {
+      throw std::runtime_error("Loaded latency benchmark not supported by this implementation");
+    }
+
+    // Whether stores first read the destination cache line (write allocate,
+    // or read for ownership), as ordinary stores do on CPUs. Not the case
+    // on GPUs or with non-temporal (streaming) stores
+    virtual bool write_allocate()
+    {
+      return false;
+    }
+
+    // Repeat each kernel reps times within every call, so that short kernels
+    // are timed over a longer interval without per-call overheads. Returns
+    // false if not supported, in which case the caller repeats the calls
+    virtual bool set_repetitions(unsigned int reps)
+    {
+      return false;
+    }
+
+    // Pointers to the arrays a, b and c, for implementations whose arrays
+    // live in host memory, so kernels from HostKernel.h can run over them
+    virtual void host_arrays(T **a, T **b, T **c)
+    {
+      throw std::runtime_error("Host kernels not supported by this implementation");
+    }
+
 };
 
 
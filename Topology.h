@@ -0,0 +1,264 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Host CPU topology read from sysfs, restricted to the CPUs this process
+// may run on
+struct CPU
+{
+  int id;
+  int package; // Physical package (socket)
+  int core;    // Core within the package
+  int node;    // NUMA domain
+  int l3;      // Lowest numbered CPU sharing the L3 cache
+};
+
+// Placement of OpenMP threads on the allowed CPUs
+enum class Binding
+{
+  None,    // Left to the OpenMP runtime
+  Compact, // Fill each core, including SMT siblings, before the next
+  Scatter, // Round robin over NUMA domains, one per core before SMT siblings
+  Core,    // One thread per core
+  L3       // One thread per L3 cache
+};
+
+// Parse a sysfs CPU list such as "0-3,8-11"
+inline std::vector<int> parse_cpu_list(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ','))
+  {
+    if (range.empty() || range == "\n")
+      continue;
+    int first, last;
+    const size_t dash = range.find('-');
+    first = std::stoi(range.substr(0, dash));
+    last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Read a single integer from a sysfs file, or fallback if it is missing
+inline int read_sysfs_int(const std::string& path, const int fallback)
+{
+  std::ifstream file(path);
+  int value;
+  if (file >> value)
+    return value;
+  return fallback;
+}
+
+// CPUs in the affinity mask of this process
+inline std::vector<int> allowed_cpus()
+{
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+  }
+#endif
+  return cpus;
+}
+
+inline std::vector<CPU> read_topology()
+{
+  const std::string sysfs = "/sys/devices/system/";
+  std::vector<CPU> topology;
+
+  for (int id : allowed_cpus())
+  {
+    const std::string dir = sysfs + "cpu/cpu" + std::to_string(id) + "/topology/";
+    const int package = read_sysfs_int(dir + "physical_package_id", 0);
+    const int core = read_sysfs_int(dir + "core_id", id);
+
+    // CPUs without an L3 cache are treated as having their own
+    int l3 = id;
+    for (int index = 0; index < 8; index++)
+    {
+      const std::string cache = sysfs + "cpu/cpu" + std::to_string(id) + "/cache/index" + std::to_string(index) + "/";
+      if (read_sysfs_int(cache + "level", 0) != 3)
+        continue;
+      std::ifstream file(cache + "shared_cpu_list");
+      std::string list;
+      std::getline(file, list);
+      const std::vector<int> shared = parse_cpu_list(list);
+      if (!shared.empty())
+        l3 = shared.front();
+    }
+
+    topology.push_back({id, package, core, 0, l3});
+  }
+
+  // Domains without a cpulist are left as domain 0
+  const std::vector<int> nodes = parse_cpu_list([&]{
+    std::ifstream file(sysfs + "node/online");
+    std::string list;
+    std::getline(file, list);
+    return list;
+  }());
+  for (int node : nodes)
+  {
+    std::ifstream file(sysfs + "node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    std::getline(file, list);
+    for (int id : parse_cpu_list(list))
+      for (CPU& cpu : topology)
+        if (cpu.id == id)
+          cpu.node = node;
+  }
+
+  return topology;
+}
+
+// Whether two CPUs are SMT siblings on the same core. Core ids are only
+// unique within a package
+inline bool same_core(const CPU& x, const CPU& y)
+{
+  return x.package == y.package && x.core == y.core;
+}
+
+// L3 cache of a CPU
+inline int topology_l3(const std::vector<CPU>& topology, const int id)
+{
+  for (const CPU& cpu : topology)
+    if (cpu.id == id)
+      return cpu.l3;
+  return id;
+}
+
+// NUMA domains with at least one allowed CPU, in increasing order
+inline std::vector<int> topology_nodes(const std::vector<CPU>& topology)
+{
+  std::vector<int> nodes;
+  for (const CPU& cpu : topology)
+    if (std::find(nodes.begin(), nodes.end(), cpu.node) == nodes.end())
+      nodes.push_back(cpu.node);
+  std::sort(nodes.begin(), nodes.end());
+  return nodes;
+}
+
+// CPUs for each thread under a binding policy, up to threads of them
+// (or as many as the policy places if threads is 0)
+inline std::vector<int> binding_cpus(const std::vector<CPU>& topology, const Binding policy, const unsigned int threads)
+{
+  std::vector<CPU> sorted = topology;
+  std::sort(sorted.begin(), sorted.end(), [](const CPU& x, const CPU& y) {
+    return x.node != y.node ? x.node < y.node
+      : x.package != y.package ? x.package < y.package
+      : x.core != y.core ? x.core < y.core : x.id < y.id;
+  });
+
+  // First CPU of each core, and the SMT siblings which follow
+  std::vector<CPU> first, siblings;
+  for (size_t i = 0; i < sorted.size(); i++)
+    (i > 0 && same_core(sorted[i], sorted[i-1]) ? siblings : first).push_back(sorted[i]);
+
+  std::vector<int> cpus;
+  switch (policy)
+  {
+    case Binding::None:
+    case Binding::Compact:
+      for (const CPU& cpu : sorted)
+        cpus.push_back(cpu.id);
+      break;
+    case Binding::Core:
+      for (const CPU& cpu : first)
+        cpus.push_back(cpu.id);
+      break;
+    case Binding::L3:
+      for (const CPU& cpu : first)
+        if (std::none_of(cpus.begin(), cpus.end(), [&](int id){ return topology_l3(topology, id) == cpu.l3; }))
+          cpus.push_back(cpu.id);
+      break;
+    case Binding::Scatter:
+      for (const std::vector<CPU>* set : {&first, &siblings})
+      {
+        // Take the next CPU from each domain in turn
+        std::vector<int> nodes = topology_nodes(*set);
+        std::vector<size_t> next(nodes.size(), 0);
+        for (size_t taken = 0; taken < set->size();)
+        {
+          for (size_t n = 0; n < nodes.size(); n++)
+          {
+            while (next[n] < set->size() && (*set)[next[n]].node != nodes[n])
+              next[n]++;
+            if (next[n] < set->size())
+            {
+              cpus.push_back((*set)[next[n]++].id);
+              taken++;
+            }
+          }
+        }
+      }
+      break;
+  }
+
+  if (threads > cpus.size())
+    throw std::runtime_error("Binding places at most " + std::to_string(cpus.size()) + " threads on the allowed CPUs, but "
+      + std::to_string(threads) + " were requested");
+  if (threads > 0)
+    cpus.resize(threads);
+  return cpus;
+}
+
+// CPU each OpenMP thread is running on, indexed by thread number
+inline std::vector<int> thread_cpus()
+{
+  std::vector<int> cpus;
+#if defined(_OPENMP) && defined(__linux__)
+  #pragma omp parallel
+  {
+    #pragma omp single
+    cpus.resize(omp_get_num_threads());
+    cpus[omp_get_thread_num()] = sched_getcpu();
+  }
+#endif
+  return cpus;
+}
+
+// Use one OpenMP thread per entry of cpus, bound to that CPU
+inline void bind_threads(const std::vector<int>& cpus)
+{
+#if defined(_OPENMP) && defined(__linux__)
+  omp_set_num_threads(cpus.size());
+  #pragma omp parallel
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[omp_get_thread_num()], &set);
+    sched_setaffinity(0, sizeof(set), &set);
+  }
+#else
+  throw std::runtime_error("Thread binding needs an OpenMP build on Linux");
+#endif
+}
+
@@ -14,10 +14,32 @@
 #include <algorithm>
 #include <iomanip>
 #include <cstring>
+#include <sstream>
+#include <thread>
+#include <fstream>
+#include <map>
+#include <csignal>
+#include <cstdio>
 
 #define VERSION_STRING "3.2"
 
 #include "Stream.h"
+#include "Barrier.h"
+#include "Expr.h"
+#include "HostKernel.h"
+#include "Topology.h"
+#include "Counters.h"
+#include "Energy.h"
+#include "Stats.h"
+#include "Baseline.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #if defined(CUDA)
 #include "CUDAStream.h"
@@ -43,16 +65,194 @@ unsigned int num_times = 100;
 unsigned int deviceIndex = 0;
 bool use_float = false;
 
+// Benchmark to run
+enum class Benchmark {All, Transfers, Pipeline, Queues, Replay, DotDevice, NUMA, Images, Local, Expression, HostKernels, Intensity, Latency, LoadedLatency, ThreadsSweep, Daemon, Soak, Tenants};
+Benchmark selection = Benchmark::All;
+
+// Elements per chunk in the pipelined Triad
+unsigned int pipeline_chunk = 0;
+
+// Number of concurrent kernel partitions
+unsigned int num_queues = 1;
+
+// Work-group size and passes over local memory in the local memory benchmark
+unsigned int local_wgsize = 256;
+unsigned int local_repeats = 100;
+
+// Source of the expression kernel run by --expr
+std::string expr_source;
+
+// Timer resolution and the cost of reading it, in seconds
+double timer_tick = 0.0;
+double timer_overhead = 0.0;
+
+// Cost of entering and leaving an empty OpenMP parallel region, in seconds
+double fork_join = 0.0;
+
+// Shortest sample before kernels are repeated in each sample: at least
+// MIN_TICKS timer ticks, MIN_FORK_JOINS parallel regions and MIN_SAMPLE_TIME
+#define MIN_TICKS 20
+#define MIN_FORK_JOINS 100
+#define MIN_SAMPLE_TIME 100.0E-6
+
+// Host CPUs this process may use, read before any threads are bound
+std::vector<CPU> topology;
+
+// Placement of OpenMP threads, and whether to print it
+Binding binding = Binding::None;
+bool show_placement = false;
+
+// Also report bandwidth counting the read for ownership of stored lines
+bool count_rfo = false;
+
+// Hardware counters around the kernels in run(), if requested
+bool use_counters = false;
+Counters *counters = nullptr;
+uint64_t counter_start[Counters::NumEvents];
+
+// Package and DRAM energy around the kernels in run(), if requested
+bool use_energy = false;
+std::string powercap_root = POWERCAP_ROOT;
+Energy *energy = nullptr;
+std::vector<uint64_t> energy_start;
+
+// Seconds between probes in daemon mode, and the node exporter textfile
+// the results are written to
+unsigned int daemon_interval = 0;
+std::string textfile_path = "babelstream.prom";
+volatile std::sig_atomic_t daemon_stop = 0;
+
+// Stored bandwidth to compare run() against, in MBytes/sec per kernel, and
+// the percentage a kernel may fall below it before the run fails
+std::map<std::string, double> baseline;
+double baseline_tolerance = 5.0;
+bool regressed = false;
+
+// Independent streams run side by side on disjoint groups of cores
+unsigned int num_tenants = 0;
+
+// This process's rank and the number of ranks; always 0 and 1 without MPI
+int mpi_rank = 0;
+int mpi_size = 1;
+
+// Length of a soak run and of each window in it, in seconds
+unsigned int soak_duration = 0;
+unsigned int soak_window = 10;
+
+// Fraction of the peak bandwidth taken as the saturation point
+#define SATURATION_FRACTION 0.9
+
+// Dependent loads timed in each sample of the latency benchmark
+#define LATENCY_LOADS (1 << 18)
+
+// Machine epsilon of 16 bit floats, for checking half images
+#define HALF_EPSILON 9.765625E-4
+
+// Smallest message in the transfer size sweep
+#define TRANSFER_MIN_BYTES 4096
+
 template <typename T>
 void check_solution(const unsigned int ntimes, std::vector<T>& a, std::vector<T>& b, std::vector<T>& c, T& sum);
 
+template <typename T>
+void check_expr(const Expr& expression, const unsigned int ntimes, std::vector<T>& a, std::vector<T>& b, std::vector<T>& c);
+
+template <typename T>
+void check_arrays(const T gold[3], std::vector<T>& a, std::vector<T>& b, std::vector<T>& c,
+  const double epsi = std::numeric_limits<T>::epsilon() * 100.0);
+
+template <typename T>
+Stream<T> *make_stream(const unsigned int array_size, std::vector<T>& a, std::vector<T>& b, std::vector<T>& c);
+
+template <typename T>
+void run_selected();
+
 template <typename T>
 void run();
 
+template <typename T>
+void run_transfers();
+
+template <typename T>
+void run_pipeline();
+
+template <typename T>
+void run_queues();
+
+template <typename T>
+void run_replay();
+
+template <typename T>
+void run_dot_device();
+
+template <typename T>
+void run_numa();
+
+template <typename T>
+void run_images();
+
+template <typename T>
+void run_local();
+
+template <typename T>
+void run_expr();
+
+template <typename T>
+void run_host_kernels();
+
+template <typename T>
+void run_intensity();
+
+template <typename T>
+void run_latency();
+
+template <typename T>
+void run_loaded_latency();
+
+template <typename T>
+void run_threads_sweep();
+
+template <typename T>
+void run_daemon();
+
+template <typename T>
+void run_soak();
+
+template <typename T>
+void run_tenants();
+
+void print_table_header(const std::string& first);
+void print_table_row(const std::string& label, const size_t bytes, std::vector<double>& timings);
+
+void calibrate_timer();
+void setup_affinity();
+
+void counters_start();
+void counters_stop(std::vector<uint64_t>& totals, std::vector<double>& joules, const unsigned int iteration);
+void print_counters_header();
+void print_counters_row(const std::string& label, const size_t bytes, const std::vector<uint64_t>& totals, const unsigned int calls);
+void print_energy_header();
+void print_energy_row(const std::string& label, const size_t bytes, const std::vector<double>& joules, const std::vector<double>& timings, const unsigned int calls);
+void print_baseline_header();
+void print_baseline_row(const std::string& label, const size_t bytes, std::vector<double>& timings);
+
+void mpi_barrier();
+void print_mpi_tables(const std::string labels[5], const size_t sizes[5], std::vector<std::vector<double>>& timings);
+
 void parseArguments(int argc, char *argv[]);
 
 int main(int argc, char *argv[])
 {
+#ifdef USE_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+  // Only rank 0 reports; errors from every rank still reach std::cerr
+  if (mpi_rank != 0)
+    std::cout.setstate(std::ios::failbit);
+#endif
+
   std::cout
     << "BabelStream" << std::endl
     << "Version: " << VERSION_STRING << std::endl
@@ -60,14 +260,177 @@ int main(int argc, char *argv[])
 
   parseArguments(argc, argv);
 
+#ifdef USE_MPI
+  if (selection != Benchmark::All)
+  {
+    std::cerr << "MPI builds only run the standard kernels" << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  // Ranks sharing a node use consecutive devices from deviceIndex
+  MPI_Comm node;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, mpi_rank, MPI_INFO_NULL, &node);
+  int local_rank;
+  MPI_Comm_rank(node, &local_rank);
+  MPI_Comm_free(&node);
+  deviceIndex += local_rank;
+  std::cout << "Ranks: " << mpi_size << std::endl;
+#endif
+
+  calibrate_timer();
+
+  // Opened before any threads are created, so they are counted too
+  if (use_counters)
+  {
+    counters = new Counters();
+    if (!counters->unavailable().empty())
+      std::cout << "Hardware counters unavailable:" << counters->unavailable() << std::endl;
+  }
+
+  if (use_energy)
+  {
+    energy = new Energy(powercap_root);
+    if (!energy->available(Energy::Package) && !energy->available(Energy::DRAM))
+      std::cout << "Energy counters unavailable: no package or DRAM zones under " << powercap_root << std::endl;
+  }
+
+  setup_affinity();
+
   // TODO: Fix Kokkos to allow multiple template specializations
 #ifndef KOKKOS
   if (use_float)
-    run<float>();
+    run_selected<float>();
   else
 #endif
-    run<double>();
+    run_selected<double>();
+
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
+
+  if (regressed)
+    exit(EXIT_FAILURE);
+}
+
+template <typename T>
+void run_selected()
+{
+  try
+  {
+    switch (selection)
+    {
+      case Benchmark::All:
+        run<T>();
+        break;
+      case Benchmark::Transfers:
+        run_transfers<T>();
+        break;
+      case Benchmark::Pipeline:
+        run_pipeline<T>();
+        break;
+      case Benchmark::Queues:
+        run_queues<T>();
+        break;
+      case Benchmark::Replay:
+        run_replay<T>();
+        break;
+      case Benchmark::DotDevice:
+        run_dot_device<T>();
+        break;
+      case Benchmark::NUMA:
+        run_numa<T>();
+        break;
+      case Benchmark::Images:
+        run_images<T>();
+        break;
+      case Benchmark::Local:
+        run_local<T>();
+        break;
+      case Benchmark::Expression:
+        run_expr<T>();
+        break;
+      case Benchmark::HostKernels:
+        run_host_kernels<T>();
+        break;
+      case Benchmark::Intensity:
+        run_intensity<T>();
+        break;
+      case Benchmark::Latency:
+        run_latency<T>();
+        break;
+      case Benchmark::LoadedLatency:
+        run_loaded_latency<T>();
+        break;
+      case Benchmark::ThreadsSweep:
+        run_threads_sweep<T>();
+        break;
+      case Benchmark::Daemon:
+        run_daemon<T>();
+        break;
+      case Benchmark::Soak:
+        run_soak<T>();
+        break;
+      case Benchmark::Tenants:
+        run_tenants<T>();
+        break;
+    }
+  }
+  catch (std::runtime_error& err)
+  {
+    // Modes a backend does not provide throw from the Stream hooks
+    std::string message = err.what();
+    const std::string generic = "this implementation";
+    const size_t pos = message.find(generic);
+    if (pos != std::string::npos)
+      message.replace(pos, generic.size(), IMPLEMENTATION_STRING);
+    std::cerr << std::endl << message << std::endl;
+#ifdef USE_MPI
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+#endif
+    exit(EXIT_FAILURE);
+  }
+}
+
+template <typename T>
+Stream<T> *make_stream(const unsigned int array_size, std::vector<T>& a, std::vector<T>& b, std::vector<T>& c)
+{
+  Stream<T> *stream;
+
+#if defined(CUDA)
+  // Use the CUDA implementation
+  stream = new CUDAStream<T>(array_size, deviceIndex);
+
+#elif defined(HIP)
+  // Use the HIP implementation
+  stream = new HIPStream<T>(array_size, deviceIndex);
+
+#elif defined(OCL)
+  // Use the OpenCL implementation
+  stream = new OCLStream<T>(array_size, deviceIndex);
+
+#elif defined(USE_RAJA)
+  // Use the RAJA implementation
+  stream = new RAJAStream<T>(array_size, deviceIndex);
+
+#elif defined(KOKKOS)
+  // Use the Kokkos implementation
+  stream = new KOKKOSStream<T>(array_size, deviceIndex);
+
+#elif defined(ACC)
+  // Use the OpenACC implementation
+  stream = new ACCStream<T>(array_size, a.data(), b.data(), c.data(), deviceIndex);
+
+#elif defined(SYCL)
+  // Use the SYCL implementation
+  stream = new SYCLStream<T>(array_size, deviceIndex);
+
+#elif defined(OMP)
+  // Use the OpenMP implementation
+  stream = new OMPStream<T>(array_size, a.data(), b.data(), c.data(), deviceIndex);
+
+#endif
 
+  return stream;
 }
 
 template <typename T>
@@ -95,129 +458,2123 @@ void run()
   // Result of the Dot kernel
   T sum;
 
-  Stream<T> *stream;
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
 
-#if defined(CUDA)
-  // Use the CUDA implementation
-  stream = new CUDAStream<T>(ARRAY_SIZE, deviceIndex);
+  stream->init_arrays(startA, startB, startC);
 
-#elif defined(HIP)
-  // Use the HIP implementation
-  stream = new HIPStream<T>(ARRAY_SIZE, deviceIndex);
+  // Declare timers
+  std::chrono::high_resolution_clock::time_point t1, t2;
 
-#elif defined(OCL)
-  // Use the OpenCL implementation
-  stream = new OCLStream<T>(ARRAY_SIZE, deviceIndex);
+  // Repeat the kernels within each sample if the shortest would otherwise
+  // be too short to time, or be dominated by launch or fork/join costs
+  double shortest = std::numeric_limits<double>::max();
+  for (int k = 0; k < 3; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->copy();
+    t2 = std::chrono::high_resolution_clock::now();
+    shortest = std::min(shortest, std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+  const double min_sample = std::max({MIN_TICKS * std::max(timer_tick, timer_overhead), MIN_FORK_JOINS * fork_join, MIN_SAMPLE_TIME});
+  unsigned int reps = std::max(1.0, std::ceil(min_sample / shortest));
+#ifdef USE_MPI
+  // Every rank times the same number of repetitions
+  MPI_Allreduce(MPI_IN_PLACE, &reps, 1, MPI_UNSIGNED, MPI_MAX, MPI_COMM_WORLD);
+#endif
+  const unsigned int calls = stream->set_repetitions(reps) ? 1 : reps;
+
+  std::cout << "Each test will take on the order of " << (unsigned int)(shortest * 1.0E6) << " microseconds" << std::endl;
+  std::cout << "Repeating each kernel " << reps << " times per sample" << std::endl;
+
+  // List of times
+  std::vector<std::vector<double>> timings(5);
+
+  // Hardware counter totals for each kernel
+  std::vector<std::vector<uint64_t>> counts(5, std::vector<uint64_t>(Counters::NumEvents, 0));
+
+  // Joules used in each energy domain by each kernel
+  std::vector<std::vector<double>> energy_used(5, std::vector<double>(Energy::NumDomains, 0.0));
+
+  // Main loop
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    // Execute Copy
+    mpi_barrier();
+    counters_start();
+    t1 = std::chrono::high_resolution_clock::now();
+    for (unsigned int r = 0; r < calls; r++)
+      stream->copy();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / reps);
+    counters_stop(counts[0], energy_used[0], k);
+
+    // Execute Mul
+    mpi_barrier();
+    counters_start();
+    t1 = std::chrono::high_resolution_clock::now();
+    for (unsigned int r = 0; r < calls; r++)
+      stream->mul();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / reps);
+    counters_stop(counts[1], energy_used[1], k);
+
+    // Execute Add
+    mpi_barrier();
+    counters_start();
+    t1 = std::chrono::high_resolution_clock::now();
+    for (unsigned int r = 0; r < calls; r++)
+      stream->add();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[2].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / reps);
+    counters_stop(counts[2], energy_used[2], k);
+
+    // Execute Triad
+    mpi_barrier();
+    counters_start();
+    t1 = std::chrono::high_resolution_clock::now();
+    for (unsigned int r = 0; r < calls; r++)
+      stream->triad();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[3].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / reps);
+    counters_stop(counts[3], energy_used[3], k);
+
+    // Execute Dot
+    mpi_barrier();
+    counters_start();
+    t1 = std::chrono::high_resolution_clock::now();
+    for (unsigned int r = 0; r < calls; r++)
+      sum = stream->dot();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[4].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / reps);
+    counters_stop(counts[4], energy_used[4], k);
+
+  }
+
+  // Check solutions
+  stream->read_arrays(a, b, c);
+  check_solution<T>(num_times, a, b, c, sum);
+
+  // Display timing results
+  if (mpi_size > 1)
+    std::cout << "Rank 0" << std::endl;
+  print_table_header("Function");
+
+  std::string labels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
+  size_t sizes[5] = {
+    2 * sizeof(T) * ARRAY_SIZE,
+    2 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE,
+    2 * sizeof(T) * ARRAY_SIZE
+  };
+
+  for (int i = 0; i < 5; i++)
+    print_table_row(labels[i], sizes[i], timings[i]);
+
+  if (mpi_size > 1)
+    print_mpi_tables(labels, sizes, timings);
+
+  if (count_rfo && stream->write_allocate())
+  {
+    // Stores which allocate in the cache read the destination array first
+    std::cout << std::endl << "Including write allocate traffic" << std::endl;
+    print_table_header("Function");
+    for (int i = 0; i < 5; i++)
+      print_table_row(labels[i], sizes[i] + (i < 4 ? sizeof(T) * ARRAY_SIZE : 0), timings[i]);
+  }
+  else if (count_rfo)
+    std::cout << std::endl << "No write allocate traffic: the stores of this implementation do not read the destination" << std::endl;
+
+  if (counters)
+  {
+    std::cout << std::endl << "Hardware counters per kernel" << std::endl;
+    print_counters_header();
+    for (int i = 0; i < 5; i++)
+      print_counters_row(labels[i], sizes[i], counts[i], (num_times - 1) * reps);
+  }
+
+  if (energy)
+  {
+    // RAPL counters update about once a millisecond, so kernels much
+    // shorter than that are only measured over many repetitions
+    std::cout << std::endl << "Energy per kernel" << std::endl;
+    print_energy_header();
+    for (int i = 0; i < 5; i++)
+      print_energy_row(labels[i], sizes[i], energy_used[i], timings[i], (num_times - 1) * reps);
+  }
+
+  if (!baseline.empty())
+  {
+    std::cout << std::endl << "Compared with baseline (tolerance " << std::setprecision(1) << baseline_tolerance << "%)" << std::endl;
+    print_baseline_header();
+    for (int i = 0; i < 5; i++)
+      print_baseline_row(labels[i], sizes[i], timings[i]);
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_transfers()
+{
+  std::cout << "Running transfers " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  const size_t max_bytes = ARRAY_SIZE * sizeof(T);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Largest transfer: " << max_bytes*1.0E-6 << " MB"
+    << " (=" << max_bytes*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  // Sweep message sizes up to a whole array
+  std::vector<size_t> sweep;
+  for (size_t bytes = TRANSFER_MIN_BYTES; bytes < max_bytes; bytes *= 4)
+    sweep.push_back(bytes);
+  sweep.push_back(max_bytes);
+
+  struct
+  {
+    const char *name;
+    Transfer dir;
+    bool pinned;
+  } tests[] = {
+    {"Host to device (pageable)", Transfer::HostToDevice,   false},
+    {"Host to device (pinned)",   Transfer::HostToDevice,   true},
+    {"Device to host (pageable)", Transfer::DeviceToHost,   false},
+    {"Device to host (pinned)",   Transfer::DeviceToHost,   true},
+    {"Bidirectional (pageable)",  Transfer::Bidirectional,  false},
+    {"Bidirectional (pinned)",    Transfer::Bidirectional,  true},
+    {"Device to device",          Transfer::DeviceToDevice, false}
+  };
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (auto& test : tests)
+  {
+    std::cout << std::endl << test.name << std::endl;
+    print_table_header("Bytes");
+
+    for (size_t bytes : sweep)
+    {
+      std::vector<double> timings;
+      for (unsigned int k = 0; k < num_times; k++)
+      {
+        t1 = std::chrono::high_resolution_clock::now();
+        stream->transfer(test.dir, test.pinned, bytes);
+        t2 = std::chrono::high_resolution_clock::now();
+        timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+      }
+
+      // Bidirectional moves the message both ways, and device to device
+      // both reads and writes it, as the Copy kernel does
+      size_t moved = (test.dir == Transfer::HostToDevice || test.dir == Transfer::DeviceToHost) ? bytes : 2 * bytes;
+
+      std::ostringstream label;
+      if (bytes < 1024*1024)
+        label << bytes / 1024 << " KB";
+      else
+        label << bytes / (1024*1024) << " MB";
+      print_table_row(label.str(), moved, timings);
+    }
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_pipeline()
+{
+  std::cout << "Running pipelined Triad " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  if (pipeline_chunk > ARRAY_SIZE)
+    pipeline_chunk = ARRAY_SIZE;
+  const unsigned int num_chunks = (ARRAY_SIZE + pipeline_chunk - 1) / pipeline_chunk;
+  const unsigned int device_size = PIPELINE_SLOTS * pipeline_chunk;
+
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Host array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout << "Chunk size: " << pipeline_chunk*sizeof(T)*1.0E-6 << " MB"
+    << " (" << num_chunks << " chunks)" << std::endl;
+  std::cout << "Device size: " << 3.0*device_size*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << 3.0*device_size*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  // Host resident arrays
+  std::vector<T> a(ARRAY_SIZE, startA);
+  std::vector<T> b(ARRAY_SIZE, startB);
+  std::vector<T> c(ARRAY_SIZE);
+
+  // startC is zero, which would hide the c term of Triad; vary c by chunk
+  // instead, so an upload to the wrong slot or out of order is caught
+  for (size_t i = 0; i < ARRAY_SIZE; i++)
+    c[i] = (T)startA * (1 + (i / pipeline_chunk) % 8);
+
+  // The device only holds the chunks in flight
+  std::vector<T> d_a(device_size);
+  std::vector<T> d_b(device_size);
+  std::vector<T> d_c(device_size);
+  Stream<T> *stream = make_stream<T>(device_size, d_a, d_b, d_c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  // Pipeline, then its stages on their own: upload and download of a
+  // single chunk, and Triad over all the chunks resident on the device
+  std::vector<std::vector<double>> timings(4);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->pipeline_triad(a, b, c);
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  // Check solution
+  double errA = 0.0;
+  for (size_t i = 0; i < ARRAY_SIZE; i++)
+    errA += fabs(a[i] - (b[i] + (T)startScalar * c[i]));
+  errA /= a.size();
+  if (errA > std::numeric_limits<T>::epsilon() * 100.0)
+    std::cerr
+      << "Validation failed on a[]. Average error " << errA
+      << std::endl;
+
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->transfer(Transfer::HostToDevice, false, pipeline_chunk*sizeof(T));
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->triad();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[2].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->transfer(Transfer::DeviceToHost, false, pipeline_chunk*sizeof(T));
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[3].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  print_table_header("Function");
+  print_table_row("Pipeline", 3 * sizeof(T) * ARRAY_SIZE, timings[0]);
+  print_table_row("Upload", sizeof(T) * pipeline_chunk, timings[1]);
+  print_table_row("Triad", 3 * sizeof(T) * device_size, timings[2]);
+  print_table_row("Download", sizeof(T) * pipeline_chunk, timings[3]);
+
+  // Without overlap each chunk would upload b and c, run Triad and download a in turn
+  double best[4];
+  for (int i = 0; i < 4; i++)
+    best[i] = *std::min_element(timings[i].begin()+1, timings[i].end());
+  const double serial = num_chunks * (2.0 * best[1] + best[2] / PIPELINE_SLOTS + best[3]);
+
+  std::cout
+    << std::endl
+    << "Serialised estimate: " << std::setprecision(3) << 1.0E-6 * 3 * sizeof(T) * ARRAY_SIZE / serial
+    << " MBytes/sec (" << std::setprecision(5) << serial << " sec)" << std::endl
+    << "Overlap speedup: " << std::setprecision(2) << serial / best[0] << "x" << std::endl;
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_queues()
+{
+  std::cout << "Running kernels " << num_times << " times over " << num_queues << " partitions" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout << "Total size: " << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  struct
+  {
+    const char *name;
+    unsigned int partitions;
+    bool out_of_order;
+  } configs[] = {
+    {"Single in-order queue",     1,          false},
+    {"Multiple in-order queues",  num_queues, false},
+    {"Single out-of-order queue", num_queues, true}
+  };
+
+  std::string labels[4] = {"Copy", "Mul", "Add", "Triad"};
+  size_t sizes[4] = {
+    2 * sizeof(T) * ARRAY_SIZE,
+    2 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE
+  };
+
+  // Best time of each kernel on a single in-order queue
+  double single_queue[4];
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (auto& config : configs)
+  {
+    stream->set_partitions(config.partitions, config.out_of_order);
+
+    std::vector<std::vector<double>> timings(4);
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        t1 = std::chrono::high_resolution_clock::now();
+        switch (i)
+        {
+          case 0: stream->copy(); break;
+          case 1: stream->mul(); break;
+          case 2: stream->add(); break;
+          case 3: stream->triad(); break;
+        }
+        t2 = std::chrono::high_resolution_clock::now();
+        timings[i].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+      }
+    }
+
+    std::cout << std::endl << config.name << " (" << config.partitions << " partitions)" << std::endl;
+    print_table_header("Function");
+    for (int i = 0; i < 4; i++)
+      print_table_row(labels[i], sizes[i], timings[i]);
+
+    std::cout << "Speedup over single queue:";
+    for (int i = 0; i < 4; i++)
+    {
+      double best = *std::min_element(timings[i].begin()+1, timings[i].end());
+      if (config.partitions == 1 && !config.out_of_order)
+        single_queue[i] = best;
+      std::cout << " " << labels[i] << " " << std::setprecision(2) << single_queue[i] / best << "x";
+    }
+    std::cout << std::endl;
+  }
+
+  // Check solutions
+  stream->set_partitions(1, false);
+  T sum = stream->dot();
+  stream->read_arrays(a, b, c);
+  check_solution<T>(num_times * 3, a, b, c, sum);
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_replay()
+{
+  std::cout << "Running kernel sequence " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout << "Total size: " << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  T sum;
+
+  // Each kernel enqueued and waited for in turn, then the recorded sequence
+  std::vector<std::vector<double>> timings(2);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->copy();
+    stream->mul();
+    stream->add();
+    stream->triad();
+    sum = stream->dot();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    sum = stream->replay();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  // Check solutions
+  stream->read_arrays(a, b, c);
+  check_solution<T>(num_times * 2, a, b, c, sum);
+
+  // Copy, Mul, Add, Triad and Dot together touch 12 arrays
+  const size_t bytes = 12 * sizeof(T) * ARRAY_SIZE;
+
+  print_table_header("Function");
+  print_table_row("Enqueue", bytes, timings[0]);
+  print_table_row("Replay", bytes, timings[1]);
+
+  double best[2];
+  for (int i = 0; i < 2; i++)
+    best[i] = *std::min_element(timings[i].begin()+1, timings[i].end());
+
+  std::cout
+    << std::endl
+    << "Overhead saved per launch: " << std::setprecision(2)
+    << 1.0E6 * (best[0] - best[1]) / 5 << " us" << std::endl;
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_dot_device()
+{
+  std::cout << "Running Dot " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  // Partial sums finished on the host, then on the device
+  T sums[2];
+  std::vector<std::vector<double>> timings(2);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    sums[0] = stream->dot();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    sums[1] = stream->dot_on_device();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  // Check solutions; no kernel has modified the arrays
+  stream->read_arrays(a, b, c);
+  for (int i = 0; i < 2; i++)
+    check_solution<T>(0, a, b, c, sums[i]);
+
+  print_table_header("Function");
+  print_table_row("Dot host", 2 * sizeof(T) * ARRAY_SIZE, timings[0]);
+  print_table_row("Dot device", 2 * sizeof(T) * ARRAY_SIZE, timings[1]);
+
+  double best[2];
+  for (int i = 0; i < 2; i++)
+    best[i] = *std::min_element(timings[i].begin()+1, timings[i].end());
+
+  std::cout
+    << std::endl
+    << "Latency saved: " << std::setprecision(2)
+    << 1.0E6 * (best[0] - best[1]) << " us" << std::endl;
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_numa()
+{
+  std::cout << "Running kernels " << num_times << " times on each NUMA domain" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout << "Total size: " << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << 3.0*ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  // One stream per domain, each over its own share of the arrays
+  std::vector<Stream<T>*> streams;
+  std::vector<unsigned int> domain_sizes;
+  unsigned int num_domains = 0;
+
+#if defined(OCL)
+  std::vector<cl::Device> sub_devices = getNUMADevices(deviceIndex);
+  num_domains = sub_devices.size();
+  for (unsigned int d = 0; d < num_domains; d++)
+  {
+    domain_sizes.push_back((d + 1) * (size_t)ARRAY_SIZE / num_domains - d * (size_t)ARRAY_SIZE / num_domains);
+    streams.push_back(new OCLStream<T>(domain_sizes[d], sub_devices[d]));
+  }
+#else
+  throw std::runtime_error("NUMA domain mode not supported by this implementation");
+#endif
+
+  std::cout << "NUMA domains: " << num_domains << std::endl;
+
+  // Start and end of every kernel call on every domain
+  typedef std::chrono::high_resolution_clock::time_point time_point;
+  std::vector<std::vector<time_point>> starts(num_domains), ends(num_domains);
+  std::vector<T> sums(num_domains);
+
+  // Each domain is driven by its own host thread, and all of them
+  // start each kernel together
+  Barrier barrier(num_domains);
+  std::vector<std::thread> threads;
+  for (unsigned int d = 0; d < num_domains; d++)
+  {
+    threads.push_back(std::thread([&, d]
+    {
+      Stream<T> *stream = streams[d];
+      stream->init_arrays(startA, startB, startC);
+
+      for (unsigned int k = 0; k < num_times; k++)
+      {
+        for (int i = 0; i < 5; i++)
+        {
+          barrier.wait();
+          starts[d].push_back(std::chrono::high_resolution_clock::now());
+          switch (i)
+          {
+            case 0: stream->copy(); break;
+            case 1: stream->mul(); break;
+            case 2: stream->add(); break;
+            case 3: stream->triad(); break;
+            case 4: sums[d] = stream->dot(); break;
+          }
+          ends[d].push_back(std::chrono::high_resolution_clock::now());
+        }
+      }
+    }));
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  // Check solutions over the arrays gathered from every domain
+  std::vector<T> a, b, c;
+  T sum = 0.0;
+  for (unsigned int d = 0; d < num_domains; d++)
+  {
+    std::vector<T> da(domain_sizes[d]), db(domain_sizes[d]), dc(domain_sizes[d]);
+    streams[d]->read_arrays(da, db, dc);
+    a.insert(a.end(), da.begin(), da.end());
+    b.insert(b.end(), db.begin(), db.end());
+    c.insert(c.end(), dc.begin(), dc.end());
+    sum += sums[d];
+  }
+  check_solution<T>(num_times, a, b, c, sum);
+
+  std::string labels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
+  size_t arrays[5] = {2, 2, 3, 3, 2};
+
+  // Aggregate: from the first domain starting to the last one finishing
+  std::cout << std::endl << "Aggregate" << std::endl;
+  print_table_header("Function");
+  for (int i = 0; i < 5; i++)
+  {
+    std::vector<double> timings;
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      const unsigned int n = k * 5 + i;
+      time_point first = starts[0][n], last = ends[0][n];
+      for (unsigned int d = 1; d < num_domains; d++)
+      {
+        first = std::min(first, starts[d][n]);
+        last = std::max(last, ends[d][n]);
+      }
+      timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(last - first).count());
+    }
+    print_table_row(labels[i], arrays[i] * sizeof(T) * ARRAY_SIZE, timings);
+  }
+
+  for (unsigned int d = 0; d < num_domains; d++)
+  {
+    std::cout << std::endl << "Domain " << d << std::endl;
+    print_table_header("Function");
+    for (int i = 0; i < 5; i++)
+    {
+      std::vector<double> timings;
+      for (unsigned int k = 0; k < num_times; k++)
+      {
+        const unsigned int n = k * 5 + i;
+        timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(ends[d][n] - starts[d][n]).count());
+      }
+      print_table_row(labels[i], arrays[i] * sizeof(T) * domain_sizes[d], timings);
+    }
+  }
+
+  for (Stream<T> *stream : streams)
+    delete stream;
+
+}
+
+template <typename T>
+void run_images()
+{
+  std::cout << "Running buffer and image kernels " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  // Buffer kernels for reference
+  std::vector<std::vector<double>> timings(2);
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->copy();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->triad();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  std::cout << std::endl << "Buffer" << std::endl;
+  print_table_header("Function");
+  print_table_row("Copy", 2 * sizeof(T) * ARRAY_SIZE, timings[0]);
+  print_table_row("Triad", 3 * sizeof(T) * ARRAY_SIZE, timings[1]);
+
+  struct
+  {
+    const char *name;
+    bool linear;
+    bool half;
+  } configs[] = {
+    {"Image RGBA float (tiled)",  false, false},
+    {"Image RGBA half (tiled)",   false, true},
+    {"Image RGBA float (linear)", true,  false},
+    {"Image RGBA half (linear)",  true,  true}
+  };
+
+  // Images hold 32 or 16 bit floats whatever the precision of the arrays
+  for (auto& config : configs)
+  {
+    const size_t bytes = stream->init_images(config.linear, config.half);
+    const size_t elements = bytes / (config.half ? 2 : 4);
+
+    timings.assign(2, std::vector<double>());
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      t1 = std::chrono::high_resolution_clock::now();
+      stream->image_copy();
+      t2 = std::chrono::high_resolution_clock::now();
+      timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+
+      t1 = std::chrono::high_resolution_clock::now();
+      stream->image_triad();
+      t2 = std::chrono::high_resolution_clock::now();
+      timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+    }
+
+    // Copy then Triad, as in the timed loop
+    float gold[3] = {startA, startB, startC};
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      gold[2] = gold[0];
+      gold[0] = gold[1] + (float)startScalar * gold[2];
+    }
+    std::vector<float> ia, ib, ic;
+    stream->read_images(ia, ib, ic);
+    check_arrays<float>(gold, ia, ib, ic, (config.half ? HALF_EPSILON : std::numeric_limits<float>::epsilon()) * 100.0);
+
+    // Tiled images hold whole rows, and linear ones are limited in size,
+    // so they may cover fewer elements than the arrays
+    std::cout << std::endl << config.name << ": " << elements << (config.half ? " half" : " float") << " elements";
+    if (elements != ARRAY_SIZE)
+      std::cout << " (of " << ARRAY_SIZE << ")";
+    std::cout << std::endl;
+    print_table_header("Function");
+    print_table_row("Copy", 2 * bytes, timings[0]);
+    print_table_row("Triad", 3 * bytes, timings[1]);
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_local()
+{
+  std::cout << "Running local memory kernels " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::cout << "Work-group size: " << local_wgsize
+    << " (" << local_wgsize*LOCAL_ELEMENTS*sizeof(T) << " bytes of local memory per array)" << std::endl;
+  std::cout << "Passes over local memory: " << local_repeats << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  struct
+  {
+    std::string name;
+    LocalAccess pattern;
+    unsigned int stride;
+  } configs[] = {
+    {"Copy",      LocalAccess::Copy,      1},
+    {"Broadcast", LocalAccess::Broadcast, 1},
+    {"Stride 1",  LocalAccess::Stride,    1},
+    {"Stride 2",  LocalAccess::Stride,    2},
+    {"Stride 4",  LocalAccess::Stride,    4},
+    {"Stride 8",  LocalAccess::Stride,    8},
+    {"Stride 16", LocalAccess::Stride,    16},
+    {"Stride 32", LocalAccess::Stride,    32}
+  };
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  std::cout << std::endl;
+  print_table_header("Access");
+
+  for (auto& config : configs)
+  {
+    size_t bytes = 0;
+    std::vector<double> timings;
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      t1 = std::chrono::high_resolution_clock::now();
+      bytes = stream->local_bandwidth(config.pattern, local_wgsize, local_repeats, config.stride);
+      t2 = std::chrono::high_resolution_clock::now();
+      timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+    }
+
+    print_table_row(config.name, bytes, timings);
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_expr()
+{
+  const Expr expression(expr_source);
+
+  std::cout << "Running expression kernel " << num_times << " times" << std::endl;
+  std::cout << "Expression: " << expression.str() << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  // Each array read is loaded once per element, plus the store
+  std::cout << "Arrays read: " << expression.arrays_read() << ", written: 1" << std::endl;
+  const size_t bytes = (expression.arrays_read() + 1) * sizeof(T) * ARRAY_SIZE;
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+  stream->init_expr(expression.code());
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  std::vector<double> timings;
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    t1 = std::chrono::high_resolution_clock::now();
+    stream->expr();
+    t2 = std::chrono::high_resolution_clock::now();
+    timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+
+  // Check solutions
+  stream->read_arrays(a, b, c);
+  check_expr<T>(expression, num_times, a, b, c);
+
+  print_table_header("Function");
+  print_table_row("Expr", bytes, timings);
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_host_kernels()
+{
+  using namespace host_kernels;
+
+  Array<T, 0> a;
+  Array<T, 1> b;
+  Array<T, 2> c;
+  Scalar<T> s(startScalar);
+
+  // Kernels over a, b and c, one line each
+  std::vector<Kernel<T>> kernels = {
+    make_kernel<T>("Copy",      c = a),
+    make_kernel<T>("Mul",       b = s * c),
+    make_kernel<T>("Add",       c = a + b),
+    make_kernel<T>("Triad",     a = b + s * c),
+    make_kernel<T>("Nstream",   a = a + b + s * c),
+    make_kernel<T>("ScaleAdd",  b = s * a + b),
+    make_kernel<T>("MultiTerm", c = s * a * b + (a - b) * s * s + c)
+  };
+
+  std::cout << "Running host kernels " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> h_a(ARRAY_SIZE);
+  std::vector<T> h_b(ARRAY_SIZE);
+  std::vector<T> h_c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, h_a, h_b, h_c);
+
+  stream->init_arrays(startA, startB, startC);
+
+  T *arrays[3];
+  stream->host_arrays(&arrays[0], &arrays[1], &arrays[2]);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  std::vector<std::vector<double>> timings(kernels.size());
+  for (unsigned int k = 0; k < num_times; k++)
+  {
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+      t1 = std::chrono::high_resolution_clock::now();
+      kernels[i].run(arrays, ARRAY_SIZE);
+      t2 = std::chrono::high_resolution_clock::now();
+      timings[i].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+    }
+  }
+
+  // Check solutions
+  T gold[3] = {startA, startB, startC};
+  for (unsigned int k = 0; k < num_times; k++)
+    for (auto& kernel : kernels)
+      kernel.apply(gold);
+
+  stream->read_arrays(h_a, h_b, h_c);
+  check_arrays<T>(gold, h_a, h_b, h_c);
+
+  print_table_header("Function");
+  for (size_t i = 0; i < kernels.size(); i++)
+    print_table_row(kernels[i].name, kernels[i].bytes * ARRAY_SIZE, timings[i]);
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_intensity()
+{
+  std::cout << "Running arithmetic intensity Triad " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  // c is non-zero so the chains settle on a non-trivial value
+  stream->init_arrays(startA, startB, startA);
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  std::cout
+    << std::left << std::setw(12) << "FMAs"
+    << std::left << std::setw(12) << "Flop/byte"
+    << std::left << std::setw(12) << "GBytes/sec"
+    << std::left << std::setw(12) << "GFLOP/s"
+    << std::left << std::setw(12) << "Min (sec)" << std::endl;
+  std::cout << std::fixed;
+
+  const size_t bytes = 3 * sizeof(T) * ARRAY_SIZE;
+
+  for (unsigned int fmas = 1; fmas <= INTENSITY_MAX_FMAS; fmas *= 2)
+  {
+    std::vector<double> timings;
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      t1 = std::chrono::high_resolution_clock::now();
+      stream->intensity_triad(fmas);
+      t2 = std::chrono::high_resolution_clock::now();
+      timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+    }
+
+    // Check solutions
+    const unsigned int chains = std::min(fmas, (unsigned int)INTENSITY_CHAINS);
+    const T scalar = startScalar;
+    T gold[3] = {0.0, startB, startA};
+    for (unsigned int j = 0; j < chains; j++)
+    {
+      T x = gold[1] + j;
+      for (unsigned int f = 0; f < fmas / chains; f++)
+        x = x * scalar + gold[2];
+      gold[0] += x;
+    }
+    stream->read_arrays(a, b, c);
+    check_arrays<T>(gold, a, b, c);
+
+    // Two flops per FMA, plus the adds combining the chains
+    const double flops = (2.0 * fmas + chains - 1) * ARRAY_SIZE;
+
+    // Ignore the first result
+    const double min = *std::min_element(timings.begin()+1, timings.end());
+
+    std::cout
+      << std::left << std::setw(12) << fmas
+      << std::left << std::setw(12) << std::setprecision(3) << flops / bytes
+      << std::left << std::setw(12) << std::setprecision(3) << 1.0E-9 * bytes / min
+      << std::left << std::setw(12) << std::setprecision(3) << 1.0E-9 * flops / min
+      << std::left << std::setw(12) << std::setprecision(5) << min
+      << std::endl;
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_latency()
+{
+  // Working sets from one page up to the size of one array
+  const size_t max_bytes = (size_t)ARRAY_SIZE * sizeof(T);
+
+  std::cout << "Running pointer chasing " << num_times << " times" << std::endl;
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Largest working set: " << max_bytes*1.0E-6 << " MB"
+    << " (=" << max_bytes*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+  std::cout << "Latency in ns per load, averaged over " << LATENCY_LOADS << " loads per sample" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  struct
+  {
+    const char *name;
+    bool huge_pages;
+    bool within_pages;
+  } configs[] = {
+    {"Random 4K",   false, false},
+    {"Random huge", true,  false},
+    {"In-page 4K",  false, true},
+    {"In-page huge", true, true}
+  };
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  std::cout << std::endl << std::left << std::setw(12) << "Bytes";
+  for (auto& config : configs)
+    std::cout << std::left << std::setw(14) << config.name;
+  std::cout << std::endl << std::fixed;
+
+  for (size_t bytes = CHASE_PAGE; bytes <= max_bytes; bytes *= 2)
+  {
+    std::cout << std::left << std::setw(12) << bytes;
+    for (auto& config : configs)
+    {
+      stream->init_chase(bytes, config.huge_pages, config.within_pages);
+
+      // Walk the whole chain once so it is cached if it fits
+      stream->chase(bytes / CHASE_LINE);
+
+      std::vector<double> timings;
+      for (unsigned int k = 0; k < num_times; k++)
+      {
+        t1 = std::chrono::high_resolution_clock::now();
+        stream->chase(LATENCY_LOADS);
+        t2 = std::chrono::high_resolution_clock::now();
+        timings.push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+      }
+
+      // Ignore the first result
+      double average = std::accumulate(timings.begin()+1, timings.end(), 0.0) / (double)(timings.size() - 1);
+      std::cout << std::left << std::setw(14) << std::setprecision(2) << 1.0E9 * average / LATENCY_LOADS;
+    }
+    std::cout << std::endl;
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_loaded_latency()
+{
+  // The chain spans one array so it is well outside the caches
+  const size_t bytes = (size_t)ARRAY_SIZE * sizeof(T);
+
+  std::cout << "Running pointer chasing under Triad load " << num_times << " times" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+  std::cout << "Latency in ns per load over huge pages, averaged over " << LATENCY_LOADS << " loads per sample" << std::endl;
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+
+  stream->init_arrays(startA, startB, startC);
+  stream->init_chase(bytes, true, false);
+
+  // Mean ns per load and Triad bytes/sec with Triad held to rate
+  auto measure = [&](const double rate, double& latency, double& bandwidth)
+  {
+    std::chrono::high_resolution_clock::time_point t1, t2;
+    double total_time = 0.0;
+    size_t total_bytes = 0;
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      t1 = std::chrono::high_resolution_clock::now();
+      size_t moved = stream->loaded_chase(LATENCY_LOADS, rate);
+      t2 = std::chrono::high_resolution_clock::now();
+
+      // Ignore the first result
+      if (k == 0)
+        continue;
+      total_time += std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count();
+      total_bytes += moved;
+    }
+    latency = 1.0E9 * total_time / ((num_times - 1) * LATENCY_LOADS);
+    bandwidth = total_bytes / total_time;
+  };
+
+  // Each step aims for a fraction of the unthrottled Triad bandwidth
+  double latency, peak;
+  measure(std::numeric_limits<double>::infinity(), latency, peak);
+  std::cout << "Unthrottled Triad: " << std::fixed << std::setprecision(3) << 1.0E-6 * peak << " MBytes/sec" << std::endl;
+
+  std::cout << std::endl
+    << std::left << std::setw(12) << "Target (%)"
+    << std::left << std::setw(12) << "ns/load"
+    << std::left << std::setw(12) << "MBytes/sec"
+    << std::left << std::setw(12) << "Reached (%)" << std::endl;
+
+  for (int percent = 0; percent <= 100; percent += 10)
+  {
+    double bandwidth;
+    measure(percent < 100 ? peak * percent / 100.0 : std::numeric_limits<double>::infinity(), latency, bandwidth);
+    std::cout
+      << std::left << std::setw(12) << percent
+      << std::left << std::setw(12) << std::setprecision(2) << latency
+      << std::left << std::setw(12) << std::setprecision(3) << 1.0E-6 * bandwidth
+      << std::left << std::setw(12) << std::setprecision(1) << 100.0 * bandwidth / peak
+      << std::endl;
+  }
+
+  delete stream;
+
+}
+
+template <typename T>
+void run_threads_sweep()
+{
+#if !(defined(OMP) || (defined(USE_RAJA) && defined(RAJA_TARGET_CPU)))
+  throw std::runtime_error("Thread sweep needs the OpenMP or RAJA CPU implementation");
+#endif
+
+  std::cout << "Running kernels " << num_times << " times at each thread count" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  if (topology.empty())
+    throw std::runtime_error("Could not read the CPU topology");
+
+  std::string labels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
+  size_t sizes[5] = {
+    2 * sizeof(T) * ARRAY_SIZE,
+    2 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE,
+    3 * sizeof(T) * ARRAY_SIZE,
+    2 * sizeof(T) * ARRAY_SIZE
+  };
+
+  std::chrono::high_resolution_clock::time_point t1, t2;
+
+  for (int node : topology_nodes(topology))
+  {
+    // One thread per core first, then the remaining SMT siblings
+    std::vector<int> order;
+    std::vector<CPU> cores;
+    for (const CPU& cpu : topology)
+    {
+      if (cpu.node != node || std::any_of(cores.begin(), cores.end(), [&](const CPU& core){ return same_core(core, cpu); }))
+        continue;
+      order.push_back(cpu.id);
+      cores.push_back(cpu);
+    }
+    const size_t num_cores = order.size();
+    for (const CPU& cpu : topology)
+      if (cpu.node == node && std::find(order.begin(), order.end(), cpu.id) == order.end())
+        order.push_back(cpu.id);
+
+    std::cout << std::endl << "NUMA domain " << node << ": "
+      << num_cores << " cores, " << order.size() << " CPUs" << std::endl;
+
+    // First touch the arrays from the whole domain, so they are local to it
+    bind_threads(order);
+    Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+    stream->init_arrays(startA, startB, startC);
+
+    std::cout << std::left << std::setw(12) << "Threads";
+    for (int i = 0; i < 5; i++)
+      std::cout << std::left << std::setw(12) << labels[i];
+    std::cout << std::endl << std::fixed;
+
+    // Best bandwidth for each kernel at each thread count
+    std::vector<std::vector<double>> bandwidth(5);
+
+    for (size_t threads = 1; threads <= order.size(); threads++)
+    {
+      bind_threads(std::vector<int>(order.begin(), order.begin() + threads));
+
+      // Pages stay where the whole domain first touched them
+      stream->init_arrays(startA, startB, startC);
+
+      T sum = 0.0;
+      std::vector<std::vector<double>> timings(5);
+      for (unsigned int k = 0; k < num_times; k++)
+      {
+        for (int i = 0; i < 5; i++)
+        {
+          t1 = std::chrono::high_resolution_clock::now();
+          switch (i)
+          {
+            case 0: stream->copy(); break;
+            case 1: stream->mul(); break;
+            case 2: stream->add(); break;
+            case 3: stream->triad(); break;
+            case 4: sum = stream->dot(); break;
+          }
+          t2 = std::chrono::high_resolution_clock::now();
+          timings[i].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+        }
+      }
+
+      stream->read_arrays(a, b, c);
+      check_solution<T>(num_times, a, b, c, sum);
+
+      std::ostringstream label;
+      label << threads << (threads > num_cores ? " (SMT)" : "");
+      std::cout << std::left << std::setw(12) << label.str();
+      for (int i = 0; i < 5; i++)
+      {
+        // Ignore the first result
+        const double min = *std::min_element(timings[i].begin()+1, timings[i].end());
+        bandwidth[i].push_back(1.0E-6 * sizes[i] / min);
+        std::cout << std::left << std::setw(12) << std::setprecision(3) << bandwidth[i].back();
+      }
+      std::cout << std::endl;
+    }
+
+    // Fewest threads reaching SATURATION_FRACTION of the best bandwidth
+    std::cout << std::left << std::setw(12) << "Saturation";
+    for (int i = 0; i < 5; i++)
+    {
+      const double peak = *std::max_element(bandwidth[i].begin(), bandwidth[i].end());
+      size_t knee = 0;
+      while (bandwidth[i][knee] < SATURATION_FRACTION * peak)
+        knee++;
+      std::cout << std::left << std::setw(12) << knee + 1;
+    }
+    std::cout << std::endl;
+
+    delete stream;
+  }
+
+}
+
+template <typename T>
+void run_daemon()
+{
+  std::cout << "Running Copy and Triad " << num_times << " times every " << daemon_interval << " seconds" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+  std::cout << "Writing metrics to " << textfile_path << std::endl;
+
+  // The arrays are allocated and initialised once, for every probe
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+  stream->init_arrays(startA, startB, startC);
+
+  std::signal(SIGINT, [](int){ daemon_stop = 1; });
+  std::signal(SIGTERM, [](int){ daemon_stop = 1; });
+
+  const char *labels[2] = {"copy", "triad"};
+  const size_t sizes[2] = {2 * sizeof(T) * ARRAY_SIZE, 3 * sizeof(T) * ARRAY_SIZE};
+
+  // Best bandwidth of each probe, in bytes per second
+  RollingStats bandwidth[2];
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point next = clock::now();
+
+  while (!daemon_stop)
+  {
+    // Best time of each kernel in this probe
+    double best[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    for (unsigned int k = 0; k < num_times; k++)
+    {
+      for (int i = 0; i < 2; i++)
+      {
+        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+        if (i == 0)
+          stream->copy();
+        else
+          stream->triad();
+        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+        best[i] = std::min(best[i], std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+      }
+    }
+    for (int i = 0; i < 2; i++)
+      bandwidth[i].add(sizes[i] / best[i]);
+
+    // Write a temporary file and rename it over the old one, so the node
+    // exporter never reads a partial file
+    const std::string temp = textfile_path + ".tmp";
+    {
+      std::ofstream file(temp);
+      const struct
+      {
+        const char *name;
+        const char *help;
+        double (RollingStats::*value)() const;
+      } metrics[] = {
+        {"babelstream_bandwidth_bytes_per_second", "Best bandwidth in the latest probe", &RollingStats::last},
+        {"babelstream_bandwidth_mean_bytes_per_second", "Mean of the best bandwidth over all probes", &RollingStats::mean},
+        {"babelstream_bandwidth_min_bytes_per_second", "Lowest best bandwidth over all probes", &RollingStats::min},
+        {"babelstream_bandwidth_max_bytes_per_second", "Highest best bandwidth over all probes", &RollingStats::max},
+        {"babelstream_bandwidth_stddev_bytes_per_second", "Standard deviation of the best bandwidth over all probes", &RollingStats::stddev}
+      };
+      file << std::setprecision(std::numeric_limits<double>::digits10);
+      for (auto& metric : metrics)
+      {
+        file << "# HELP " << metric.name << " " << metric.help << std::endl;
+        file << "# TYPE " << metric.name << " gauge" << std::endl;
+        for (int i = 0; i < 2; i++)
+          file << metric.name << "{kernel=\"" << labels[i] << "\",array_bytes=\"" << ARRAY_SIZE * sizeof(T) << "\"} "
+            << (bandwidth[i].*metric.value)() << std::endl;
+      }
+      file << "# HELP babelstream_probes_total Probes run since the daemon started" << std::endl;
+      file << "# TYPE babelstream_probes_total counter" << std::endl;
+      file << "babelstream_probes_total " << bandwidth[0].count() << std::endl;
+      file << "# HELP babelstream_last_probe_timestamp_seconds Time the latest probe finished" << std::endl;
+      file << "# TYPE babelstream_last_probe_timestamp_seconds gauge" << std::endl;
+      file << "babelstream_last_probe_timestamp_seconds "
+        << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() << std::endl;
+      if (!file)
+        throw std::runtime_error("Could not write " + temp);
+    }
+    if (std::rename(temp.c_str(), textfile_path.c_str()) != 0)
+      throw std::runtime_error("Could not rename " + temp + " to " + textfile_path);
+
+    // Sleep in short steps so a signal stops the daemon promptly
+    next += std::chrono::seconds(daemon_interval);
+    while (!daemon_stop && clock::now() < next)
+      std::this_thread::sleep_for(std::min<clock::duration>(next - clock::now(), std::chrono::milliseconds(100)));
+  }
+
+  std::cout << "Stopped after " << bandwidth[0].count() << " probes" << std::endl;
+
+  delete stream;
+}
+
+// Mean current frequency of the allowed CPUs in MHz, or 0 if cpufreq is
+// not available
+double cpu_frequency()
+{
+  double total = 0.0;
+  unsigned int cpus = 0;
+  for (const CPU& cpu : topology)
+  {
+    const int khz = read_sysfs_int("/sys/devices/system/cpu/cpu" + std::to_string(cpu.id) + "/cpufreq/scaling_cur_freq", 0);
+    if (khz > 0)
+    {
+      total += khz * 1.0E-3;
+      cpus++;
+    }
+  }
+  return cpus ? total / cpus : 0.0;
+}
+
+template <typename T>
+void run_soak()
+{
+  std::cout << "Running Triad for " << soak_duration << " seconds in " << soak_window << " second windows" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::vector<T> a(ARRAY_SIZE);
+  std::vector<T> b(ARRAY_SIZE);
+  std::vector<T> c(ARRAY_SIZE);
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB)" << std::endl;
+  std::cout.precision(ss);
+
+  Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+  stream->init_arrays(startA, startB, startC);
+
+  const size_t bytes = 3 * sizeof(T) * ARRAY_SIZE;
+
+  // Warm up, so the first window is not penalised
+  stream->triad();
+
+  std::cout
+    << std::left << std::setw(12) << "Window"
+    << std::left << std::setw(12) << "End (sec)"
+    << std::left << std::setw(12) << "MBytes/sec"
+    << std::left << std::setw(12) << "Best"
+    << std::left << std::setw(12) << "Worst"
+    << std::left << std::setw(12) << "CPU MHz" << std::endl;
+  std::cout << std::fixed;
+
+  // Mean bandwidth of each window, against the middle of the window
+  std::vector<double> times, bandwidth;
+
+  typedef std::chrono::steady_clock clock;
+  const clock::time_point start = clock::now();
+  const clock::time_point end = start + std::chrono::seconds(soak_duration);
+  clock::time_point window_start = start;
+
+  for (unsigned int w = 0; window_start < end; w++)
+  {
+    const clock::time_point window_end = std::min(end, window_start + std::chrono::seconds(soak_window));
+
+    unsigned long calls = 0;
+    double busy = 0.0;
+    double shortest = std::numeric_limits<double>::max();
+    double longest = 0.0;
+    clock::time_point now = window_start;
+    while (now < window_end)
+    {
+      const clock::time_point t1 = now;
+      stream->triad();
+      now = clock::now();
+      const double t = std::chrono::duration_cast<std::chrono::duration<double> >(now - t1).count();
+      calls++;
+      busy += t;
+      shortest = std::min(shortest, t);
+      longest = std::max(longest, t);
+    }
+
+    const double mid = 0.5 * std::chrono::duration_cast<std::chrono::duration<double> >((window_start - start) + (now - start)).count();
+    times.push_back(mid);
+    bandwidth.push_back(1.0E-6 * bytes * calls / busy);
+
+    std::ostringstream mhz;
+    const double frequency = cpu_frequency();
+    if (frequency > 0.0)
+      mhz << std::fixed << std::setprecision(0) << frequency;
+    else
+      mhz << "n/a";
+
+    std::cout
+      << std::left << std::setw(12) << w
+      << std::left << std::setw(12) << std::setprecision(1) << std::chrono::duration_cast<std::chrono::duration<double> >(now - start).count()
+      << std::left << std::setw(12) << std::setprecision(3) << bandwidth.back()
+      << std::left << std::setw(12) << 1.0E-6 * bytes / shortest
+      << std::left << std::setw(12) << 1.0E-6 * bytes / longest
+      << std::left << std::setw(12) << mhz.str() << std::endl;
+
+    window_start = now;
+  }
+
+  delete stream;
+
+  if (times.size() < 3)
+  {
+    std::cout << "Too few windows to fit a drift trend" << std::endl;
+    return;
+  }
+
+  // Slowdown is significant if the slope is negative and its 95%
+  // confidence interval excludes zero
+  const LinearFit fit = linear_fit(times, bandwidth);
+  const double t = fit.slope_error > 0.0 ? fit.slope / fit.slope_error : 0.0;
+  const bool slowdown = fit.slope < 0.0 && -t > t_critical(times.size() - 2);
+
+  std::cout << std::endl
+    << "Drift: " << std::setprecision(3) << 100.0 * fit.slope * 3600.0 / fit.intercept << "% per hour"
+    << " (" << 100.0 * fit.slope * (times.back() - times.front()) / fit.intercept << "% over the run, t = "
+    << std::setprecision(2) << t << ")" << std::endl;
+  if (slowdown)
+    std::cout << "WARNING: bandwidth fell significantly during the run" << std::endl;
+  else
+    std::cout << "No significant slowdown" << std::endl;
+}
+
+template <typename T>
+void run_tenants()
+{
+#if !(defined(OMP) || (defined(USE_RAJA) && defined(RAJA_TARGET_CPU)))
+  throw std::runtime_error("Tenants need the OpenMP or RAJA CPU implementation");
+#endif
+
+  std::cout << "Running kernels " << num_times << " times in " << num_tenants << " tenants, alone and together" << std::endl;
+
+  if (sizeof(T) == sizeof(float))
+    std::cout << "Precision: float" << std::endl;
+  else
+    std::cout << "Precision: double" << std::endl;
+
+  std::streamsize ss = std::cout.precision();
+  std::cout << std::setprecision(1) << std::fixed
+    << "Array size: " << ARRAY_SIZE*sizeof(T)*1.0E-6 << " MB"
+    << " (=" << ARRAY_SIZE*sizeof(T)*1.0E-9 << " GB) per array per tenant" << std::endl;
+  std::cout.precision(ss);
+
+  if (topology.empty())
+    throw std::runtime_error("Could not read the CPU topology");
+
+  // Whole cores, with their SMT siblings, in domain order
+  std::vector<std::vector<int>> cores;
+  const std::vector<int> order = binding_cpus(topology, Binding::Compact, 0);
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    auto cpu = std::find_if(topology.begin(), topology.end(), [&](const CPU& c){ return c.id == order[i]; });
+    auto prev = i > 0 ? std::find_if(topology.begin(), topology.end(), [&](const CPU& c){ return c.id == order[i-1]; }) : topology.end();
+    if (prev == topology.end() || prev->core != cpu->core)
+      cores.push_back(std::vector<int>());
+    cores.back().push_back(cpu->id);
+  }
+  if (num_tenants > cores.size())
+    throw std::runtime_error("Only " + std::to_string(cores.size()) + " cores for " + std::to_string(num_tenants) + " tenants");
+
+  // Consecutive, near equal shares of the cores
+  std::vector<std::vector<int>> groups(num_tenants);
+  for (unsigned int t = 0; t < num_tenants; t++)
+    for (size_t c = t * cores.size() / num_tenants; c < (t + 1) * cores.size() / num_tenants; c++)
+      groups[t].insert(groups[t].end(), cores[c].begin(), cores[c].end());
+
+  // Time of every kernel call in each tenant, alone and with the others
+  std::vector<std::vector<std::vector<double>>> alone(num_tenants, std::vector<std::vector<double>>(5));
+  std::vector<std::vector<std::vector<double>>> together(num_tenants, std::vector<std::vector<double>>(5));
+
+  // Each tenant is driven by its own host thread with its own OpenMP
+  // team. Tenants take turns to run alone, then all start together
+  Barrier barrier(num_tenants);
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < num_tenants; t++)
+  {
+    threads.push_back(std::thread([&, t]
+    {
+      bind_threads(groups[t]);
+
+      // First touched by the tenant's own team
+      std::vector<T> a(ARRAY_SIZE);
+      std::vector<T> b(ARRAY_SIZE);
+      std::vector<T> c(ARRAY_SIZE);
+      Stream<T> *stream = make_stream<T>(ARRAY_SIZE, a, b, c);
+      stream->init_arrays(startA, startB, startC);
+
+      T sum = 0.0;
+      auto run_kernels = [&](std::vector<std::vector<double>>& timings)
+      {
+        for (unsigned int k = 0; k < num_times; k++)
+        {
+          for (int i = 0; i < 5; i++)
+          {
+            std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+            switch (i)
+            {
+              case 0: stream->copy(); break;
+              case 1: stream->mul(); break;
+              case 2: stream->add(); break;
+              case 3: stream->triad(); break;
+              case 4: sum = stream->dot(); break;
+            }
+            std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+            timings[i].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+          }
+        }
+      };
+
+      for (unsigned int turn = 0; turn < num_tenants; turn++)
+      {
+        barrier.wait();
+        if (turn == t)
+          run_kernels(alone[t]);
+      }
+      barrier.wait();
+      run_kernels(together[t]);
+
+      stream->read_arrays(a, b, c);
+      check_solution<T>(2 * num_times, a, b, c, sum);
+      delete stream;
+    }));
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  std::string labels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
+  size_t arrays[5] = {2, 2, 3, 3, 2};
+
+  // Sustained bandwidth from the average time, as the tenants overlap;
+  // ignore the first result
+  auto rate = [&](const std::vector<double>& timings, const int i)
+  {
+    const double average = std::accumulate(timings.begin()+1, timings.end(), 0.0) / (timings.size() - 1);
+    return 1.0E-6 * arrays[i] * sizeof(T) * ARRAY_SIZE / average;
+  };
+
+  std::cout << std::endl << "MBytes/sec of each tenant running together" << std::endl;
+  std::cout << std::left << std::setw(16) << "Tenant" << std::left << std::setw(12) << "CPUs";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << labels[i];
+  std::cout << std::endl << std::fixed;
+
+  for (unsigned int t = 0; t < num_tenants; t++)
+  {
+    std::ostringstream cpus;
+    cpus << groups[t].front() << "-" << groups[t].back();
+    std::cout << std::left << std::setw(16) << t << std::left << std::setw(12) << cpus.str();
+    for (int i = 0; i < 5; i++)
+      std::cout << std::left << std::setw(12) << std::setprecision(3) << rate(together[t][i], i);
+    std::cout << std::endl;
+  }
+
+  double total[5], mean_alone[5], fairness[5];
+  for (int i = 0; i < 5; i++)
+  {
+    // Jain's index: 1 when every tenant gets the same bandwidth, 1/K when
+    // one tenant takes it all
+    double sum = 0.0, squares = 0.0, solo = 0.0;
+    for (unsigned int t = 0; t < num_tenants; t++)
+    {
+      const double r = rate(together[t][i], i);
+      sum += r;
+      squares += r * r;
+      solo += rate(alone[t][i], i) / num_tenants;
+    }
+    total[i] = sum;
+    mean_alone[i] = solo;
+    fairness[i] = sum * sum / (num_tenants * squares);
+  }
+
+  std::cout << std::left << std::setw(28) << "Total";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << std::setprecision(3) << total[i];
+  std::cout << std::endl << std::left << std::setw(28) << "Mean alone";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << std::setprecision(3) << mean_alone[i];
+  std::cout << std::endl << std::left << std::setw(28) << "Slowdown together (%)";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << std::setprecision(1) << 100.0 * (1.0 - total[i] / num_tenants / mean_alone[i]);
+  std::cout << std::endl << std::left << std::setw(28) << "Fairness";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << std::setprecision(3) << fairness[i];
+  std::cout << std::endl;
+}
+
+void setup_affinity()
+{
+  topology = read_topology();
+
+#ifdef _OPENMP
+  const int allowed = topology.size();
+  if (binding != Binding::None)
+  {
+    // Thread count from OMP_NUM_THREADS if set, otherwise from the policy
+    const unsigned int requested = getenv("OMP_NUM_THREADS") ? omp_get_max_threads() : 0;
+    try
+    {
+      bind_threads(binding_cpus(topology, binding, requested));
+    }
+    catch (std::runtime_error& err)
+    {
+      std::cerr << err.what() << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  else if (omp_get_max_threads() > allowed)
+  {
+    std::cerr
+      << "Warning: " << omp_get_max_threads() << " threads requested but only "
+      << allowed << " CPUs are allowed" << std::endl;
+  }
+
+  if (binding != Binding::None || show_placement)
+  {
+    std::cout << "Allowed CPUs: " << allowed << std::endl;
+    std::cout
+      << std::left << std::setw(12) << "Thread"
+      << std::left << std::setw(12) << "CPU"
+      << std::left << std::setw(12) << "Package"
+      << std::left << std::setw(12) << "Core"
+      << std::left << std::setw(12) << "L3"
+      << std::left << std::setw(12) << "NUMA" << std::endl;
+    const std::vector<int> cpus = thread_cpus();
+    for (size_t t = 0; t < cpus.size(); t++)
+    {
+      for (const CPU& cpu : topology)
+      {
+        if (cpu.id != cpus[t])
+          continue;
+        std::cout
+          << std::left << std::setw(12) << t
+          << std::left << std::setw(12) << cpu.id
+          << std::left << std::setw(12) << cpu.package
+          << std::left << std::setw(12) << cpu.core
+          << std::left << std::setw(12) << cpu.l3
+          << std::left << std::setw(12) << cpu.node << std::endl;
+      }
+    }
+  }
+#else
+  if (binding != Binding::None || show_placement)
+  {
+    std::cerr << "Thread placement needs an OpenMP build" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
+}
+
+void calibrate_timer()
+{
+  typedef std::chrono::high_resolution_clock clock;
+
+  // Smallest non-zero step between readings, as in McCalpin's STREAM
+  double tick = std::numeric_limits<double>::max();
+  for (int k = 0; k < 20; k++)
+  {
+    clock::time_point t1 = clock::now();
+    clock::time_point t2;
+    do
+    {
+      t2 = clock::now();
+    } while (t2 == t1);
+    tick = std::min(tick, std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  }
+  timer_tick = tick;
+
+  // Average cost of reading the timer
+  const int readings = 1000;
+  clock::time_point t1 = clock::now();
+  for (int k = 0; k < readings; k++)
+    clock::now();
+  clock::time_point t2 = clock::now();
+  timer_overhead = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / readings;
+
+  std::cout << "Timer resolution: " << (unsigned int)(timer_tick * 1.0E9) << " ns"
+    << ", overhead: " << (unsigned int)(timer_overhead * 1.0E9) << " ns" << std::endl;
+
+#ifdef _OPENMP
+  // Average cost of a trivial parallel region, after one to start the
+  // threads. The store keeps the compiler from removing an empty region
+  const int regions = 1000;
+  volatile int sink;
+  #pragma omp parallel
+  sink = omp_get_thread_num();
+  t1 = clock::now();
+  for (int k = 0; k < regions; k++)
+  {
+    #pragma omp parallel
+    sink = omp_get_thread_num();
+  }
+  t2 = clock::now();
+  (void)sink;
+  fork_join = std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count() / regions;
+  std::cout << "OpenMP fork/join: " << (unsigned int)(fork_join * 1.0E9) << " ns" << std::endl;
+#endif
+}
+
+void counters_start()
+{
+  if (counters)
+    counters->read(counter_start);
+  if (energy)
+    energy->read(energy_start);
+}
+
+void counters_stop(std::vector<uint64_t>& totals, std::vector<double>& joules, const unsigned int iteration)
+{
+  if (energy)
+  {
+    std::vector<uint64_t> end;
+    energy->read(end);
+
+    // Ignore the first result
+    double used[Energy::NumDomains];
+    energy->joules(energy_start, end, used);
+    for (int d = 0; d < Energy::NumDomains && iteration > 0; d++)
+      joules[d] += used[d];
+  }
+
+  if (!counters)
+    return;
+
+  uint64_t end[Counters::NumEvents];
+  counters->read(end);
+
+  // Ignore the first result
+  if (iteration == 0)
+    return;
+  for (int e = 0; e < Counters::NumEvents; e++)
+    totals[e] += end[e] - counter_start[e];
+}
+
+void print_counters_header()
+{
+  std::cout
+    << std::left << std::setw(12) << "Function"
+    << std::left << std::setw(14) << "Cycles"
+    << std::left << std::setw(14) << "Instructions"
+    << std::left << std::setw(14) << "LLC misses"
+    << std::left << std::setw(14) << "DRAM MBytes"
+    << std::left << std::setw(14) << "Model MBytes" << std::endl;
+}
 
-#elif defined(USE_RAJA)
-  // Use the RAJA implementation
-  stream = new RAJAStream<T>(ARRAY_SIZE, deviceIndex);
+void print_counters_row(const std::string& label, const size_t bytes, const std::vector<uint64_t>& totals, const unsigned int calls)
+{
+  // Averages per kernel call
+  std::cout << std::left << std::setw(12) << label;
+  for (int e = 0; e < Counters::NumEvents; e++)
+  {
+    std::ostringstream value;
+    if (!counters->available((Counters::Event)e))
+      value << "n/a";
+    else if (e == Counters::DRAMBytes)
+      value << std::fixed << std::setprecision(3) << 1.0E-6 * totals[e] / calls;
+    else
+      value << totals[e] / calls;
+    std::cout << std::left << std::setw(14) << value.str();
+  }
+  std::cout << std::left << std::setw(14) << std::setprecision(3) << 1.0E-6 * bytes << std::endl;
+}
 
-#elif defined(KOKKOS)
-  // Use the Kokkos implementation
-  stream = new KOKKOSStream<T>(ARRAY_SIZE, deviceIndex);
+void print_energy_header()
+{
+  std::cout
+    << std::left << std::setw(12) << "Function"
+    << std::left << std::setw(14) << "Package J"
+    << std::left << std::setw(14) << "DRAM J"
+    << std::left << std::setw(14) << "Watts"
+    << std::left << std::setw(14) << "GB/s/W" << std::endl;
+}
 
-#elif defined(ACC)
-  // Use the OpenACC implementation
-  stream = new ACCStream<T>(ARRAY_SIZE, a.data(), b.data(), c.data(), deviceIndex);
+void print_energy_row(const std::string& label, const size_t bytes, const std::vector<double>& joules, const std::vector<double>& timings, const unsigned int calls)
+{
+  // Averages per kernel call, ignoring the first result
+  const double seconds = std::accumulate(timings.begin()+1, timings.end(), 0.0) / (timings.size() - 1);
+  const double total = (joules[Energy::Package] + joules[Energy::DRAM]) / calls;
 
-#elif defined(SYCL)
-  // Use the SYCL implementation
-  stream = new SYCLStream<T>(ARRAY_SIZE, deviceIndex);
+  std::cout << std::left << std::setw(12) << label;
+  for (int d = 0; d < Energy::NumDomains; d++)
+  {
+    std::ostringstream value;
+    if (!energy->available((Energy::Domain)d))
+      value << "n/a";
+    else
+      value << std::scientific << std::setprecision(3) << joules[d] / calls;
+    std::cout << std::left << std::setw(14) << value.str();
+  }
 
-#elif defined(OMP)
-  // Use the OpenMP implementation
-  stream = new OMPStream<T>(ARRAY_SIZE, a.data(), b.data(), c.data(), deviceIndex);
+  std::ostringstream watts, efficiency;
+  if (total > 0.0)
+  {
+    watts << std::fixed << std::setprecision(1) << total / seconds;
+    efficiency << std::fixed << std::setprecision(3) << 1.0E-9 * bytes / total;
+  }
+  else
+  {
+    watts << "n/a";
+    efficiency << "n/a";
+  }
+  std::cout << std::left << std::setw(14) << watts.str() << std::left << std::setw(14) << efficiency.str() << std::endl;
+}
 
+void mpi_barrier()
+{
+#ifdef USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
 #endif
+}
 
-  stream->init_arrays(startA, startB, startC);
-
-  // List of times
-  std::vector<std::vector<double>> timings(5);
+void print_mpi_tables(const std::string labels[5], const size_t sizes[5], std::vector<std::vector<double>>& timings)
+{
+#ifdef USE_MPI
+  // Best bandwidth of every kernel on every rank; ignore the first result
+  std::vector<double> best(5);
+  for (int i = 0; i < 5; i++)
+    best[i] = 1.0E-6 * sizes[i] / *std::min_element(timings[i].begin()+1, timings[i].end());
+  std::vector<double> all(mpi_rank == 0 ? 5 * mpi_size : 0);
+  MPI_Gather(best.data(), 5, MPI_DOUBLE, all.data(), 5, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-  // Declare timers
-  std::chrono::high_resolution_clock::time_point t1, t2;
+  char host[MPI_MAX_PROCESSOR_NAME] = {0};
+  int length;
+  MPI_Get_processor_name(host, &length);
+  std::vector<char> hosts(mpi_rank == 0 ? MPI_MAX_PROCESSOR_NAME * mpi_size : 0);
+  MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, MPI_COMM_WORLD);
 
-  // Main loop
-  for (unsigned int k = 0; k < num_times; k++)
+  // Each iteration moves the data of every rank in the time of the slowest
+  std::vector<std::vector<double>> slowest(5), fastest(5);
+  for (int i = 0; i < 5; i++)
   {
-    // Execute Copy
-    t1 = std::chrono::high_resolution_clock::now();
-    stream->copy();
-    t2 = std::chrono::high_resolution_clock::now();
-    timings[0].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
-
-    // Execute Mul
-    t1 = std::chrono::high_resolution_clock::now();
-    stream->mul();
-    t2 = std::chrono::high_resolution_clock::now();
-    timings[1].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+    slowest[i].resize(timings[i].size());
+    fastest[i].resize(timings[i].size());
+    MPI_Reduce(timings[i].data(), slowest[i].data(), timings[i].size(), MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(timings[i].data(), fastest[i].data(), timings[i].size(), MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+  }
 
-    // Execute Add
-    t1 = std::chrono::high_resolution_clock::now();
-    stream->add();
-    t2 = std::chrono::high_resolution_clock::now();
-    timings[2].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  if (mpi_rank != 0)
+    return;
 
-    // Execute Triad
-    t1 = std::chrono::high_resolution_clock::now();
-    stream->triad();
-    t2 = std::chrono::high_resolution_clock::now();
-    timings[3].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  std::cout << std::endl << "Aggregate of " << mpi_size << " ranks, timed by the slowest rank" << std::endl;
+  print_table_header("Function");
+  for (int i = 0; i < 5; i++)
+    print_table_row(labels[i], sizes[i] * mpi_size, slowest[i]);
 
-    // Execute Dot
-    t1 = std::chrono::high_resolution_clock::now();
-    sum = stream->dot();
-    t2 = std::chrono::high_resolution_clock::now();
-    timings[4].push_back(std::chrono::duration_cast<std::chrono::duration<double> >(t2 - t1).count());
+  std::cout << std::endl << "Best MBytes/sec of each rank" << std::endl;
+  std::cout << std::left << std::setw(8) << "Rank" << std::left << std::setw(20) << "Host";
+  for (int i = 0; i < 5; i++)
+    std::cout << std::left << std::setw(12) << labels[i];
+  std::cout << std::endl;
+  for (int r = 0; r < mpi_size; r++)
+  {
+    std::cout << std::left << std::setw(8) << r << std::left << std::setw(20) << &hosts[r * MPI_MAX_PROCESSOR_NAME];
+    for (int i = 0; i < 5; i++)
+      std::cout << std::left << std::setw(12) << std::setprecision(3) << all[r * 5 + i];
+    std::cout << std::endl;
+  }
 
+  // Spread between the slowest and fastest rank
+  std::cout << std::left << std::setw(28) << "Imbalance (%)";
+  for (int i = 0; i < 5; i++)
+  {
+    double lo = std::numeric_limits<double>::max(), hi = 0.0;
+    for (int r = 0; r < mpi_size; r++)
+    {
+      lo = std::min(lo, all[r * 5 + i]);
+      hi = std::max(hi, all[r * 5 + i]);
+    }
+    std::cout << std::left << std::setw(12) << std::setprecision(1) << 100.0 * (hi - lo) / hi;
   }
+  std::cout << std::endl;
 
-  // Check solutions
-  stream->read_arrays(a, b, c);
-  check_solution<T>(num_times, a, b, c, sum);
+  // How much longer the slowest rank takes in each iteration
+  std::cout << std::left << std::setw(28) << "Mean max/min time";
+  for (int i = 0; i < 5; i++)
+  {
+    // Ignore the first result
+    double ratio = 0.0;
+    for (size_t k = 1; k < slowest[i].size(); k++)
+      ratio += slowest[i][k] / fastest[i][k] / (slowest[i].size() - 1);
+    std::cout << std::left << std::setw(12) << std::setprecision(3) << ratio;
+  }
+  std::cout << std::endl;
+#endif
+}
 
-  // Display timing results
+void print_baseline_header()
+{
   std::cout
     << std::left << std::setw(12) << "Function"
     << std::left << std::setw(12) << "MBytes/sec"
-    << std::left << std::setw(12) << "Min (sec)"
-    << std::left << std::setw(12) << "Max"
-    << std::left << std::setw(12) << "Average" << std::endl;
+    << std::left << std::setw(12) << "Baseline"
+    << std::left << std::setw(12) << "Delta (%)" << std::endl;
+}
 
-  std::cout << std::fixed;
+void print_baseline_row(const std::string& label, const size_t bytes, std::vector<double>& timings)
+{
+  // Kernels missing from older results, such as Dot, are not compared
+  auto reference = baseline.find(label);
+  if (reference == baseline.end())
+    return;
 
-  std::string labels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
-  size_t sizes[5] = {
-    2 * sizeof(T) * ARRAY_SIZE,
-    2 * sizeof(T) * ARRAY_SIZE,
-    3 * sizeof(T) * ARRAY_SIZE,
-    3 * sizeof(T) * ARRAY_SIZE,
-    2 * sizeof(T) * ARRAY_SIZE
-  };
+  // Ignore the first result
+  const double rate = 1.0E-6 * bytes / *std::min_element(timings.begin()+1, timings.end());
+  const double delta = 100.0 * (rate - reference->second) / reference->second;
+  const bool regression = delta < -baseline_tolerance;
+  regressed |= regression;
 
-  for (int i = 0; i < 5; i++)
-  {
-    // Get min/max; ignore the first result
-    auto minmax = std::minmax_element(timings[i].begin()+1, timings[i].end());
+  std::cout
+    << std::left << std::setw(12) << label
+    << std::left << std::setw(12) << std::setprecision(3) << rate
+    << std::left << std::setw(12) << std::setprecision(3) << reference->second
+    << std::left << std::setw(12) << std::showpos << std::setprecision(1) << delta << std::noshowpos
+    << (regression ? "REGRESSION" : "") << std::endl;
+}
 
-    // Calculate average; ignore the first result
-    double average = std::accumulate(timings[i].begin()+1, timings[i].end(), 0.0) / (double)(num_times - 1);
+void print_table_header(const std::string& first)
+{
+  std::cout
+    << std::left << std::setw(12) << first
+    << std::left << std::setw(12) << "MBytes/sec"
+    << std::left << std::setw(12) << "Min (sec)"
+    << std::left << std::setw(12) << "Max"
+    << std::left << std::setw(12) << "Average" << std::endl;
 
-    // Display results
-    std::cout
-      << std::left << std::setw(12) << labels[i]
-      << std::left << std::setw(12) << std::setprecision(3) << 1.0E-6 * sizes[i] / (*minmax.first)
-      << std::left << std::setw(12) << std::setprecision(5) << *minmax.first
-      << std::left << std::setw(12) << std::setprecision(5) << *minmax.second
-      << std::left << std::setw(12) << std::setprecision(5) << average
-      << std::endl;
+  std::cout << std::fixed;
+}
 
-  }
+void print_table_row(const std::string& label, const size_t bytes, std::vector<double>& timings)
+{
+  // Get min/max; ignore the first result
+  auto minmax = std::minmax_element(timings.begin()+1, timings.end());
 
-  delete stream;
+  // Calculate average; ignore the first result
+  double average = std::accumulate(timings.begin()+1, timings.end(), 0.0) / (double)(timings.size() - 1);
 
+  // Display results
+  std::cout
+    << std::left << std::setw(12) << label
+    << std::left << std::setw(12) << std::setprecision(3) << 1.0E-6 * bytes / (*minmax.first)
+    << std::left << std::setw(12) << std::setprecision(5) << *minmax.first
+    << std::left << std::setw(12) << std::setprecision(5) << *minmax.second
+    << std::left << std::setw(12) << std::setprecision(5) << average
+    << std::endl;
 }
 
 template <typename T>
@@ -276,6 +2633,43 @@ void check_solution(const unsigned int ntimes, std::vector<T>& a, std::vector<T>
 
 }
 
+template <typename T>
+void check_expr(const Expr& expression, const unsigned int ntimes, std::vector<T>& a, std::vector<T>& b, std::vector<T>& c)
+{
+  // Generate correct solution
+  T gold[3] = {startA, startB, startC};
+  const T scalar = startScalar;
+
+  for (unsigned int i = 0; i < ntimes; i++)
+    expression.apply(gold, scalar);
+
+  check_arrays<T>(gold, a, b, c);
+}
+
+template <typename T>
+void check_arrays(const T gold[3], std::vector<T>& a, std::vector<T>& b, std::vector<T>& c, const double epsi)
+{
+  std::vector<T> *arrays[3] = {&a, &b, &c};
+  const char names[3] = {'a', 'b', 'c'};
+
+  for (int i = 0; i < 3; i++)
+  {
+    // Calculate the average error, relative to the solution as kernels
+    // may grow or shrink the values each time they are applied
+    const T goldI = gold[i];
+    double err = std::accumulate(arrays[i]->begin(), arrays[i]->end(), 0.0, [&](double sum, const T val){ return sum + fabs(val - goldI); });
+    err /= arrays[i]->size();
+    if (goldI != 0.0)
+      err /= fabs(goldI);
+
+    if (!(err <= epsi))
+      std::cerr
+        << "Validation failed on " << names[i] << "[]. Average error " << err
+        << std::endl;
+  }
+
+}
+
 int parseUInt(const char *str, unsigned int *output)
 {
   char *next;
@@ -283,6 +2677,22 @@ int parseUInt(const char *str, unsigned int *output)
   return !strlen(next);
 }
 
+// Seconds, with an optional s, m or h suffix
+int parseDuration(const char *str, unsigned int *output)
+{
+  char *next;
+  *output = strtoul(str, &next, 10);
+  if (next == str)
+    return 0;
+  if (!strcmp(next, "m"))
+    *output *= 60;
+  else if (!strcmp(next, "h"))
+    *output *= 3600;
+  else if (strlen(next) && strcmp(next, "s"))
+    return 0;
+  return 1;
+}
+
 void parseArguments(int argc, char *argv[])
 {
   for (int i = 1; i < argc; i++)
@@ -327,6 +2737,216 @@ void parseArguments(int argc, char *argv[])
     {
       use_float = true;
     }
+    else if (!std::string("--transfers").compare(argv[i]))
+    {
+      selection = Benchmark::Transfers;
+    }
+    else if (!std::string("--pipeline").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &pipeline_chunk) || pipeline_chunk == 0)
+      {
+        std::cerr << "Invalid pipeline chunk size." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      selection = Benchmark::Pipeline;
+    }
+    else if (!std::string("--queues").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &num_queues) || num_queues == 0)
+      {
+        std::cerr << "Invalid number of queues." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      selection = Benchmark::Queues;
+    }
+    else if (!std::string("--replay").compare(argv[i]))
+    {
+      selection = Benchmark::Replay;
+    }
+    else if (!std::string("--dot-device").compare(argv[i]))
+    {
+      selection = Benchmark::DotDevice;
+    }
+    else if (!std::string("--numa").compare(argv[i]))
+    {
+      selection = Benchmark::NUMA;
+    }
+    else if (!std::string("--images").compare(argv[i]))
+    {
+      selection = Benchmark::Images;
+    }
+    else if (!std::string("--local").compare(argv[i]))
+    {
+      selection = Benchmark::Local;
+    }
+    else if (!std::string("--local-wgsize").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &local_wgsize) || local_wgsize == 0)
+      {
+        std::cerr << "Invalid local work-group size." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--local-repeats").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &local_repeats) || local_repeats == 0)
+      {
+        std::cerr << "Invalid number of local memory passes." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--expr").compare(argv[i]))
+    {
+      if (++i >= argc)
+      {
+        std::cerr << "Missing expression." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      try
+      {
+        Expr check(argv[i]);
+      }
+      catch (std::runtime_error& err)
+      {
+        std::cerr << err.what() << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      expr_source = argv[i];
+      selection = Benchmark::Expression;
+    }
+    else if (!std::string("--host-kernels").compare(argv[i]))
+    {
+      selection = Benchmark::HostKernels;
+    }
+    else if (!std::string("--intensity").compare(argv[i]))
+    {
+      selection = Benchmark::Intensity;
+    }
+    else if (!std::string("--latency").compare(argv[i]))
+    {
+      selection = Benchmark::Latency;
+    }
+    else if (!std::string("--loaded-latency").compare(argv[i]))
+    {
+      selection = Benchmark::LoadedLatency;
+    }
+    else if (!std::string("--threads-sweep").compare(argv[i]))
+    {
+      selection = Benchmark::ThreadsSweep;
+    }
+    else if (!std::string("--daemon").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &daemon_interval) || daemon_interval == 0)
+      {
+        std::cerr << "Invalid daemon interval." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      selection = Benchmark::Daemon;
+    }
+    else if (!std::string("--baseline").compare(argv[i]))
+    {
+      if (++i >= argc)
+      {
+        std::cerr << "Missing baseline file." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      try
+      {
+        baseline = read_baseline(argv[i]);
+      }
+      catch (std::runtime_error& err)
+      {
+        std::cerr << err.what() << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--tolerance").compare(argv[i]))
+    {
+      char *next;
+      if (++i >= argc || (baseline_tolerance = strtod(argv[i], &next)) < 0.0 || strlen(next))
+      {
+        std::cerr << "Invalid tolerance." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--soak").compare(argv[i]))
+    {
+      if (++i >= argc || !parseDuration(argv[i], &soak_duration) || soak_duration == 0)
+      {
+        std::cerr << "Invalid soak duration." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      selection = Benchmark::Soak;
+    }
+    else if (!std::string("--soak-window").compare(argv[i]))
+    {
+      if (++i >= argc || !parseDuration(argv[i], &soak_window) || soak_window == 0)
+      {
+        std::cerr << "Invalid soak window." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--textfile").compare(argv[i]))
+    {
+      if (++i >= argc)
+      {
+        std::cerr << "Missing textfile." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      textfile_path = argv[i];
+    }
+    else if (!std::string("--tenants").compare(argv[i]))
+    {
+      if (++i >= argc || !parseUInt(argv[i], &num_tenants) || num_tenants == 0)
+      {
+        std::cerr << "Invalid number of tenants." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      selection = Benchmark::Tenants;
+    }
+    else if (!std::string("--bind").compare(argv[i]))
+    {
+      const std::string policy = ++i < argc ? argv[i] : "";
+      if (policy == "compact")
+        binding = Binding::Compact;
+      else if (policy == "scatter")
+        binding = Binding::Scatter;
+      else if (policy == "core")
+        binding = Binding::Core;
+      else if (policy == "l3")
+        binding = Binding::L3;
+      else
+      {
+        std::cerr << "Invalid binding policy." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (!std::string("--placement").compare(argv[i]))
+    {
+      show_placement = true;
+    }
+    else if (!std::string("--count-rfo").compare(argv[i]))
+    {
+      count_rfo = true;
+    }
+    else if (!std::string("--counters").compare(argv[i]))
+    {
+      use_counters = true;
+    }
+    else if (!std::string("--energy").compare(argv[i]))
+    {
+      use_energy = true;
+    }
+    else if (!std::string("--powercap-root").compare(argv[i]))
+    {
+      if (++i >= argc)
+      {
+        std::cerr << "Missing powercap directory." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      powercap_root = argv[i];
+      use_energy = true;
+    }
     else if (!std::string("--help").compare(argv[i]) ||
              !std::string("-h").compare(argv[i]))
     {
@@ -339,6 +2959,35 @@ void parseArguments(int argc, char *argv[])
       std::cout << "  -s  --arraysize  SIZE    Use SIZE elements in the array" << std::endl;
       std::cout << "  -n  --numtimes   NUM     Run the test NUM times (NUM >= 2)" << std::endl;
       std::cout << "      --float              Use floats (rather than doubles)" << std::endl;
+      std::cout << "      --transfers          Measure host/device transfer rates instead of kernels" << std::endl;
+      std::cout << "      --pipeline   CHUNK   Stream Triad over host arrays in chunks of CHUNK elements" << std::endl;
+      std::cout << "      --queues     NUM     Compare NUM concurrent queues against a single queue" << std::endl;
+      std::cout << "      --replay             Compare enqueueing each kernel against replaying a recorded sequence" << std::endl;
+      std::cout << "      --dot-device         Compare finishing the Dot reduction on the host and on the device" << std::endl;
+      std::cout << "      --numa               Run concurrently on one sub-device per NUMA domain" << std::endl;
+      std::cout << "      --images             Compare Copy and Triad through buffers and through images" << std::endl;
+      std::cout << "      --local              Measure on-chip local memory bandwidth and bank conflicts" << std::endl;
+      std::cout << "      --local-wgsize SIZE  Use work-groups of SIZE work-items with --local (default 256)" << std::endl;
+      std::cout << "      --local-repeats NUM  Make NUM passes over local memory with --local (default 100)" << std::endl;
+      std::cout << "      --expr       EXPR    Run a kernel generated from EXPR, e.g. \"a = b + s*c*c\"" << std::endl;
+      std::cout << "      --host-kernels       Run the expression template kernels over host arrays" << std::endl;
+      std::cout << "      --intensity          Sweep Triad from 1 to 512 FMAs per element for a roofline" << std::endl;
+      std::cout << "      --latency            Measure load latency by pointer chasing, up to the size of one array" << std::endl;
+      std::cout << "      --loaded-latency     Measure load latency while the other threads run Triad at 0-100% of its peak bandwidth" << std::endl;
+      std::cout << "      --threads-sweep      Sweep the thread count within each NUMA domain to find where it saturates" << std::endl;
+      std::cout << "      --tenants    K       Run K independent streams on disjoint groups of cores, alone and together" << std::endl;
+      std::cout << "      --daemon  INTERVAL   Probe Copy and Triad every INTERVAL seconds, keeping the arrays allocated" << std::endl;
+      std::cout << "      --textfile   FILE    Prometheus textfile written by --daemon (default babelstream.prom)" << std::endl;
+      std::cout << "      --baseline   FILE    Compare the standard kernels with a stored result and fail if one regresses" << std::endl;
+      std::cout << "      --tolerance  PCT     Percentage a kernel may fall below the baseline (default 5)" << std::endl;
+      std::cout << "      --soak    DURATION   Run Triad for DURATION (seconds, or with an m or h suffix) and fit the drift" << std::endl;
+      std::cout << "      --soak-window TIME   Length of each soak window (default 10 seconds)" << std::endl;
+      std::cout << "      --bind       POLICY  Bind OpenMP threads: compact, scatter, core (one per core) or l3 (one per L3)" << std::endl;
+      std::cout << "      --placement          Print the CPU, package, core, L3 and NUMA domain of each OpenMP thread" << std::endl;
+      std::cout << "      --count-rfo          Also report bandwidth including write allocate (read for ownership) traffic, where the stores cause it" << std::endl;
+      std::cout << "      --counters           Report hardware counters and measured DRAM traffic for each kernel" << std::endl;
+      std::cout << "      --energy             Report package and DRAM energy and bandwidth per watt for each kernel" << std::endl;
+      std::cout << "      --powercap-root DIR  Read energy counters from DIR instead of " POWERCAP_ROOT << std::endl;
       std::cout << std::endl;
       exit(EXIT_SUCCESS);
     }
@@ -349,4 +2998,12 @@ void parseArguments(int argc, char *argv[])
       exit(EXIT_FAILURE);
     }
   }
+
+  // A baseline holds the standard kernel results, so other modes have
+  // nothing to compare with it
+  if (!baseline.empty() && selection != Benchmark::All)
+  {
+    std::cerr << "--baseline only applies to the standard kernels" << std::endl;
+    exit(EXIT_FAILURE);
+  }
 }
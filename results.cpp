@@ -0,0 +1,509 @@
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+// Collects the results/ tree into one table of per kernel bandwidth, and
+// answers simple queries over it
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef USE_SQLITE
+#include <sqlite3.h>
+#endif
+
+#include "Baseline.h"
+
+const char *kernels[5] = {"Copy", "Mul", "Add", "Triad", "Dot"};
+
+// One benchmark run, with bandwidth in MBytes/sec and 0 for kernels it did
+// not report
+struct Record
+{
+  std::string version;
+  std::string device;
+  std::string model;
+  std::string compiler;
+  std::string source;
+  double bandwidth[5];
+};
+
+std::vector<Record> records;
+
+// Peak bandwidth of each device in GBytes/sec
+std::map<std::string, double> peaks;
+
+// Other names of a device, as lower case letters and digits without the
+// vendor or brand, and the name of its v2.0 directory
+const std::map<std::string, std::string> device_aliases = {
+  {"a107850kradeonr7", "a107850k"},
+  {"fijinano", "furynano"},
+  {"firepros10000", "s10000"},
+  {"firepros9150", "s9150"},
+  {"gtxtitanx", "titanx"},
+  {"phise10p", "se10p"},
+  {"r9furyx", "furyx"},
+  {"radeon7970", "hd7970"},
+  {"radeonr9290x", "r9290x"},
+  {"radeonr9295x2", "r9295x2"},
+};
+
+// One name for a device, whether it comes from a csv row (FirePro S9150),
+// a v1.0 file (amd-firepro-s9150-ecc-off) or a v2.0 directory (s9150).
+// ECC lowers both the bandwidth and the peak, so runs with it on are kept
+// apart with an -ecc-on suffix
+std::string device_name(const std::string& name, bool ecc = false)
+{
+  std::string base = name;
+  for (const std::string suffix : {"-ecc-on", "-ecc-off"})
+  {
+    if (base.size() > suffix.size() && base.compare(base.size() - suffix.size(), suffix.size(), suffix) == 0)
+    {
+      ecc = suffix == "-ecc-on";
+      base.erase(base.size() - suffix.size());
+    }
+  }
+
+  std::string key;
+  for (const char c : base)
+    if (isalnum((unsigned char)c))
+      key += tolower((unsigned char)c);
+  for (const std::string vendor : {"amd", "nvidia", "intel", "tesla", "geforce"})
+    if (key.compare(0, vendor.size(), vendor) == 0)
+      key.erase(0, vendor.size());
+
+  auto alias = device_aliases.find(key);
+  if (alias != device_aliases.end())
+    key = alias->second;
+  return ecc ? key + "-ecc-on" : key;
+}
+
+std::string stem(const std::string& path)
+{
+  const size_t slash = path.find_last_of('/');
+  std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+  return name.substr(0, name.find_last_of('.'));
+}
+
+std::string parent(const std::string& path)
+{
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "" : stem(path.substr(0, slash));
+}
+
+std::string extension(const std::string& path)
+{
+  return path.substr(path.find_last_of('.') + 1);
+}
+
+// Value after "Key: " on the first line starting with key
+std::string header(const std::string& path, const std::string& key)
+{
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    const size_t start = line.find_first_not_of(' ');
+    if (start != std::string::npos && line.compare(start, key.size(), key) == 0)
+    {
+      std::string value = line.substr(start + key.size());
+      value.erase(0, value.find_first_not_of(" :$"));
+      value.erase(value.find_last_not_of(" $") + 1);
+      return value;
+    }
+  }
+  return "";
+}
+
+// BabelStream text from any version, or McCalpin STREAM text
+void read_text(const std::string& path)
+{
+  std::map<std::string, double> bandwidth;
+  try
+  {
+    bandwidth = read_baseline(path);
+  }
+  catch (std::runtime_error&)
+  {
+    std::cerr << "Skipping " << path << ": no kernel results" << std::endl;
+    return;
+  }
+
+  Record record;
+  record.source = path;
+  for (int i = 0; i < 5; i++)
+    record.bandwidth[i] = bandwidth.count(kernels[i]) ? bandwidth[kernels[i]] : 0.0;
+
+  // v1.0 files are named after the device in a directory per model, and
+  // later ones after the model and compiler in a directory per device
+  const std::string name = stem(path);
+  if (!header(path, "STREAM version").empty())
+  {
+    record.version = header(path, "STREAM version $Revision");
+    record.device = device_name(parent(path));
+    record.model = "mccalpin";
+    const size_t dash = name.find('-');
+    record.compiler = dash == std::string::npos ? "" : name.substr(dash + 1);
+  }
+  else
+  {
+    record.version = header(path, "Version");
+    if (record.version.compare(0, 2, "0.") == 0 || record.version.compare(0, 2, "1.") == 0)
+    {
+      record.device = device_name(name);
+      record.model = parent(path) == "opencl" ? "ocl" : parent(path);
+    }
+    else
+    {
+      const size_t dash = name.find('-');
+      record.device = device_name(parent(path));
+      record.model = name.substr(0, dash);
+      record.compiler = dash == std::string::npos ? "" : name.substr(dash + 1);
+    }
+  }
+  records.push_back(record);
+}
+
+std::vector<std::string> split_csv(const std::string& line)
+{
+  std::vector<std::string> fields;
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, ','))
+    fields.push_back(field);
+  return fields;
+}
+
+// Spreadsheet of v1.0 OpenCL results, with the peak bandwidth of each device.
+// It does not say which version produced each row
+void read_csv(const std::string& path)
+{
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  const std::vector<std::string> columns = split_csv(line);
+  auto column = [&](const std::string& name) {
+    return std::find(columns.begin(), columns.end(), name) - columns.begin();
+  };
+
+  while (std::getline(file, line))
+  {
+    const std::vector<std::string> fields = split_csv(line);
+    if (fields.size() != columns.size())
+      continue;
+
+    Record record;
+    record.device = device_name(fields[column("Device")], fields[column("ECC")] == "On");
+    record.model = "ocl";
+    record.source = path;
+    for (int i = 0; i < 5; i++)
+    {
+      const size_t c = column(kernels[i]);
+      record.bandwidth[i] = c < fields.size() ? atof(fields[c].c_str()) : 0.0;
+    }
+    records.push_back(record);
+
+    const size_t peak = column("Peak");
+    if (peak < fields.size())
+      peaks[record.device] = atof(fields[peak].c_str());
+  }
+}
+
+void read_tree(const std::string& path)
+{
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    throw std::runtime_error("Could not read " + path);
+
+  if (!S_ISDIR(info.st_mode))
+  {
+    if (extension(path) == "txt")
+      read_text(path);
+    else if (extension(path) == "csv")
+      read_csv(path);
+    else
+      std::cerr << "Skipping " << path << ": unknown format" << std::endl;
+    return;
+  }
+
+  DIR *dir = opendir(path.c_str());
+  std::vector<std::string> entries;
+  while (struct dirent *entry = readdir(dir))
+    if (entry->d_name[0] != '.')
+      entries.push_back(entry->d_name);
+  closedir(dir);
+
+  // Sorted, so the output does not depend on the file system
+  std::sort(entries.begin(), entries.end());
+  for (const std::string& entry : entries)
+    read_tree(path + "/" + entry);
+}
+
+// The spreadsheet repeats the v1.0 OpenCL text results, so its rows are
+// only kept for runs without a text file
+void drop_duplicates()
+{
+  std::set<std::pair<std::string, std::string>> text;
+  for (const Record& record : records)
+    if (extension(record.source) == "txt" && (record.version.compare(0, 2, "0.") == 0 || record.version.compare(0, 2, "1.") == 0))
+      text.insert(std::make_pair(record.device, record.model));
+
+  records.erase(std::remove_if(records.begin(), records.end(), [&](const Record& record) {
+    return extension(record.source) == "csv" && text.count(std::make_pair(record.device, record.model));
+  }), records.end());
+}
+
+// Device and peak GBytes/sec on each line
+void read_peaks(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Could not open " + path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    const std::vector<std::string> fields = split_csv(line);
+    if (fields.size() == 2 && atof(fields[1].c_str()) > 0.0)
+      peaks[device_name(fields[0])] = atof(fields[1].c_str());
+  }
+}
+
+std::string quote(const std::string& field)
+{
+  if (field.find_first_of(",\"") == std::string::npos)
+    return field;
+  std::string quoted = "\"";
+  for (char c : field)
+    quoted += c == '"' ? "\"\"" : std::string(1, c);
+  return quoted + "\"";
+}
+
+void write_csv()
+{
+  std::cout << "version,device,model,compiler";
+  for (const char *kernel : kernels)
+    std::cout << "," << kernel;
+  std::cout << ",source" << std::endl;
+
+  std::cout << std::fixed << std::setprecision(3);
+  for (const Record& record : records)
+  {
+    std::cout << quote(record.version) << "," << quote(record.device) << ","
+      << quote(record.model) << "," << quote(record.compiler);
+    for (int i = 0; i < 5; i++)
+    {
+      std::cout << ",";
+      if (record.bandwidth[i] > 0.0)
+        std::cout << record.bandwidth[i];
+    }
+    std::cout << "," << quote(record.source) << std::endl;
+  }
+}
+
+#ifdef USE_SQLITE
+void write_sqlite(const std::string& path)
+{
+  sqlite3 *db;
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+    throw std::runtime_error("Could not open " + path + ": " + sqlite3_errmsg(db));
+
+  auto exec = [&](const char *sql) {
+    char *error;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK)
+    {
+      const std::string message = error;
+      sqlite3_free(error);
+      throw std::runtime_error("SQLite: " + message);
+    }
+  };
+
+  exec("DROP TABLE IF EXISTS results; DROP TABLE IF EXISTS peaks;"
+       "CREATE TABLE results (version TEXT, device TEXT, model TEXT, compiler TEXT,"
+       " copy REAL, mul REAL, add_ REAL, triad REAL, dot REAL, source TEXT);"
+       "CREATE TABLE peaks (device TEXT PRIMARY KEY, gbytes REAL);"
+       "BEGIN;");
+
+  sqlite3_stmt *insert;
+  sqlite3_prepare_v2(db, "INSERT INTO results VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", -1, &insert, nullptr);
+  for (const Record& record : records)
+  {
+    const std::string *text[4] = {&record.version, &record.device, &record.model, &record.compiler};
+    for (int i = 0; i < 4; i++)
+      sqlite3_bind_text(insert, i + 1, text[i]->c_str(), -1, SQLITE_TRANSIENT);
+    for (int i = 0; i < 5; i++)
+    {
+      if (record.bandwidth[i] > 0.0)
+        sqlite3_bind_double(insert, i + 5, record.bandwidth[i]);
+      else
+        sqlite3_bind_null(insert, i + 5);
+    }
+    sqlite3_bind_text(insert, 10, record.source.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(insert);
+    sqlite3_reset(insert);
+  }
+  sqlite3_finalize(insert);
+
+  sqlite3_prepare_v2(db, "INSERT INTO peaks VALUES (?, ?)", -1, &insert, nullptr);
+  for (auto& peak : peaks)
+  {
+    sqlite3_bind_text(insert, 1, peak.first.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(insert, 2, peak.second);
+    sqlite3_step(insert);
+    sqlite3_reset(insert);
+  }
+  sqlite3_finalize(insert);
+
+  exec("COMMIT;");
+  sqlite3_close(db);
+}
+#endif
+
+int kernel_index(const std::string& name)
+{
+  for (int i = 0; i < 5; i++)
+    if (!strcasecmp(name.c_str(), kernels[i]))
+      return i;
+  throw std::runtime_error("Unknown kernel " + name);
+}
+
+// Fastest model for a kernel on each device
+void query_best(const int k)
+{
+  std::map<std::string, const Record *> best;
+  for (const Record& record : records)
+  {
+    const Record *&current = best[record.device];
+    if (record.bandwidth[k] > 0.0 && (!current || record.bandwidth[k] > current->bandwidth[k]))
+      current = &record;
+  }
+
+  std::cout << "device,model,compiler,version," << kernels[k] << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  for (auto& device : best)
+  {
+    if (!device.second)
+      continue;
+    std::cout << quote(device.first) << "," << quote(device.second->model) << ","
+      << quote(device.second->compiler) << "," << quote(device.second->version) << ","
+      << device.second->bandwidth[k] << std::endl;
+  }
+}
+
+// Percentage of peak reached by every run on a device with a known peak
+void query_peak(const int k)
+{
+  std::cout << "device,model,compiler,version," << kernels[k] << ",peak,percent" << std::endl;
+  std::cout << std::fixed;
+  for (const Record& record : records)
+  {
+    auto peak = peaks.find(record.device);
+    if (peak == peaks.end() || record.bandwidth[k] <= 0.0)
+      continue;
+    std::cout << quote(record.device) << "," << quote(record.model) << ","
+      << quote(record.compiler) << "," << quote(record.version) << ","
+      << std::setprecision(3) << record.bandwidth[k] << ","
+      << std::setprecision(1) << peak->second << ","
+      << 0.1 * record.bandwidth[k] / peak->second << std::endl;
+  }
+}
+
+void usage(const char *name)
+{
+  std::cout << std::endl;
+  std::cout << "Usage: " << name << " [OPTIONS] [PATH...]" << std::endl << std::endl;
+  std::cout << "Reads BabelStream and McCalpin STREAM text, and the v1.0 OpenCL csv, from each" << std::endl;
+  std::cout << "PATH (default results) and prints one csv row per run" << std::endl << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  -h  --help               Print the message" << std::endl;
+  std::cout << "      --best    KERNEL     Print the fastest model on each device for KERNEL" << std::endl;
+  std::cout << "      --peak    KERNEL     Print the percentage of peak bandwidth reached for KERNEL" << std::endl;
+  std::cout << "      --peaks   FILE       Peak GBytes/sec for more devices, as device,peak lines" << std::endl;
+#ifdef USE_SQLITE
+  std::cout << "      --sqlite  FILE       Also write the results and peaks tables to an SQLite database" << std::endl;
+#endif
+  std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> paths;
+  std::string best, peak, sqlite;
+
+  try
+  {
+    std::vector<std::string> peak_files;
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg = argv[i];
+      if (arg == "--help" || arg == "-h")
+      {
+        usage(argv[0]);
+        exit(EXIT_SUCCESS);
+      }
+      else if ((arg == "--best" || arg == "--peak" || arg == "--peaks" || arg == "--sqlite") && i + 1 < argc)
+      {
+        const std::string value = argv[++i];
+        if (arg == "--best")
+          best = value;
+        else if (arg == "--peak")
+          peak = value;
+        else if (arg == "--peaks")
+          peak_files.push_back(value);
+        else
+          sqlite = value;
+      }
+      else if (arg.compare(0, 1, "-") == 0)
+      {
+        std::cerr << "Unrecognized argument '" << arg << "' (try '--help')" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      else
+        paths.push_back(arg);
+    }
+
+    if (paths.empty())
+      paths.push_back("results");
+    for (const std::string& path : paths)
+      read_tree(path);
+    drop_duplicates();
+    for (const std::string& path : peak_files)
+      read_peaks(path);
+
+    if (!sqlite.empty())
+    {
+#ifdef USE_SQLITE
+      write_sqlite(sqlite);
+#else
+      throw std::runtime_error("Built without SQLite support; rebuild with SQLITE=1");
+#endif
+    }
+
+    if (!best.empty())
+      query_best(kernel_index(best));
+    else if (!peak.empty())
+      query_peak(kernel_index(peak));
+    else if (sqlite.empty())
+      write_csv();
+  }
+  catch (std::runtime_error& err)
+  {
+    std::cerr << err.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,62 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+#include "../Baseline.h"
+
+int failures = 0;
+
+void expect(const std::string& path, const std::map<std::string, double>& expected)
+{
+  const std::map<std::string, double> bandwidth = read_baseline(path);
+  if (bandwidth.size() != expected.size())
+  {
+    std::cerr << path << ": read " << bandwidth.size() << " kernels, expected " << expected.size() << std::endl;
+    failures++;
+  }
+  for (const auto& kernel : expected)
+  {
+    auto found = bandwidth.find(kernel.first);
+    if (found == bandwidth.end() || std::fabs(found->second - kernel.second) > 1.0E-6 * kernel.second)
+    {
+      std::cerr << path << ": " << kernel.first << " is "
+        << (found == bandwidth.end() ? std::string("missing") : std::to_string(found->second))
+        << ", expected " << kernel.second << std::endl;
+      failures++;
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const std::string dir = argc > 1 ? argv[1] : ".";
+
+  // Only the first table counts, not the MPI, write allocate, counter,
+  // energy or baseline comparison tables that follow it. The comparison
+  // leaves out Dot, so the Dot row of the energy table would be read last
+  expect(dir + "/tests/baseline-extra-tables.txt",
+    {{"Copy", 100000.0}, {"Mul", 101000.0}, {"Add", 102000.0}, {"Triad", 103000.0}, {"Dot", 104000.0}});
+
+  // McCalpin STREAM output, where Scale is read as Mul
+  expect(dir + "/results/v2.0/knl/mccalpin-intel.txt",
+    {{"Copy", 387306.5}, {"Mul", 414238.4}, {"Add", 444668.2}, {"Triad", 447436.7}});
+
+  // Version 1.0 output, which has no Dot kernel
+  expect(dir + "/results/v1.0/hip/amd-fiji-nano.txt",
+    {{"Copy", 375822.410}, {"Mul", 375086.879}, {"Add", 425650.718}, {"Triad", 424710.113}});
+
+  if (failures)
+  {
+    std::cerr << failures << " baseline checks failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Baseline tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
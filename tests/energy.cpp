@@ -0,0 +1,61 @@
+
+// Copyright (c) 2015-16 Tom Deakin, Simon McIntosh-Smith,
+// University of Bristol HPC
+//
+// For full license terms please see the LICENSE file distributed with this
+// source code
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+#include "../Energy.h"
+
+int failures = 0;
+
+void expect(const bool condition, const std::string& what)
+{
+  if (!condition)
+  {
+    std::cerr << "Failed: " << what << std::endl;
+    failures++;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const std::string dir = argc > 1 ? argv[1] : ".";
+
+  // The fake tree has a package, core and dram zone, the MMIO copy of the
+  // package zone and a second package without a readable counter
+  Energy energy(dir + "/tests/powercap");
+  expect(energy.available(Energy::Package), "package zone found");
+  expect(energy.available(Energy::DRAM), "dram zone found");
+
+  // Only intel-rapl:0 and intel-rapl:0:1 are read, in that order
+  std::vector<uint64_t> start;
+  energy.read(start);
+  expect(start.size() == 2, "two zones read, skipping core, intel-rapl-mmio:0 and intel-rapl:1");
+  if (start.size() != 2)
+    return EXIT_FAILURE;
+  expect(start[0] == 262143000000 && start[1] == 2000000, "zone counters read");
+
+  // The package counter wraps past max_energy_range_uj; dram does not
+  const std::vector<uint64_t> end = {1000000, 5000000};
+  double used[Energy::NumDomains];
+  energy.joules(start, end, used);
+  expect(std::fabs(used[Energy::Package] - 1.328850) < 1.0E-9, "package joules across the wrap");
+  expect(std::fabs(used[Energy::DRAM] - 3.0) < 1.0E-9, "dram joules");
+
+  // A missing root leaves no zones
+  Energy missing(dir + "/tests/no-such-powercap");
+  expect(!missing.available(Energy::Package) && !missing.available(Energy::DRAM), "no zones without a powercap tree");
+
+  if (failures)
+  {
+    std::cerr << failures << " energy checks failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Energy tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}